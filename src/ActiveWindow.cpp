@@ -0,0 +1,133 @@
+#include "ActiveWindow.h"
+
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+void ActiveWindow::init(Display *newDisplay, Window newRoot, EventMasks *newMasks,
+                        unsigned long *counter) {
+    display = newDisplay;
+    root = newRoot;
+    masks = newMasks;
+    roundTrips = counter;
+    atomActiveWindow = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+    atomWmName = XInternAtom(display, "_NET_WM_NAME", False);
+    atomUtf8String = XInternAtom(display, "UTF8_STRING", False);
+
+    readActive();
+    matchRule();
+}
+
+void ActiveWindow::setRules(const std::vector<AppRule> *newRules) {
+    rules = newRules;
+    matchRule();
+}
+
+bool ActiveWindow::handleEvent(const XEvent &ev) {
+    if (ev.type != PropertyNotify || display == nullptr)
+        return false;
+
+    const XPropertyEvent &e = ev.xproperty;
+    if (e.window == root && e.atom == atomActiveWindow)
+        readActive();
+    else if (e.window == active && active != None &&
+             (e.atom == atomWmName || e.atom == XA_WM_NAME || e.atom == XA_WM_CLASS))
+        readProperties();
+    else
+        return false;
+    return matchRule();
+}
+
+void ActiveWindow::readActive() {
+    Window window = None;
+    Atom type;
+    int format;
+    unsigned long count, after;
+    unsigned char *data = nullptr;
+    (*roundTrips)++;
+    if (XGetWindowProperty(display, root, atomActiveWindow, 0, 1, False, XA_WINDOW, &type, &format,
+                           &count, &after, &data) == Success &&
+        data) {
+        if (type == XA_WINDOW && format == 32 && count == 1)
+            window = *(Window *)data;
+        XFree(data);
+    }
+    if (window == active)
+        return;
+
+    // Only the title of the focused window is followed
+    if (active != None)
+        masks->remove(active, PropertyChangeMask);
+    active = window;
+    instance.clear();
+    className.clear();
+    title.clear();
+    if (active == None)
+        return;
+
+    // Select first, so no change after reading is missed
+    XWindowAttributes atr;
+    (*roundTrips)++;
+    if (!XGetWindowAttributes(display, active, &atr)) {
+        // Already gone
+        active = None;
+        return;
+    }
+    masks->add(active, PropertyChangeMask);
+    readProperties();
+}
+
+void ActiveWindow::readProperties() {
+    instance.clear();
+    className.clear();
+    title.clear();
+
+    XClassHint hint;
+    (*roundTrips)++;
+    if (XGetClassHint(display, active, &hint)) {
+        if (hint.res_name) {
+            instance = hint.res_name;
+            XFree(hint.res_name);
+        }
+        if (hint.res_class) {
+            className = hint.res_class;
+            XFree(hint.res_class);
+        }
+    }
+
+    // The EWMH title in UTF-8, or the old one in Latin-1 from clients that don't set it
+    Atom type;
+    int format;
+    unsigned long count, after;
+    unsigned char *data = nullptr;
+    (*roundTrips)++;
+    if (XGetWindowProperty(display, active, atomWmName, 0, 1024, False, atomUtf8String, &type,
+                           &format, &count, &after, &data) == Success &&
+        data) {
+        if (type == atomUtf8String && format == 8)
+            title.assign((const char *)data, count);
+        XFree(data);
+    }
+    if (title.empty()) {
+        char *name = nullptr;
+        (*roundTrips)++;
+        if (XFetchName(display, active, &name) && name) {
+            title = name;
+            XFree(name);
+        }
+    }
+}
+
+bool ActiveWindow::matchRule() {
+    int index = -1;
+    if (rules && active != None) {
+        for (int i = 0; i < (int)rules->size(); i++) {
+            if ((*rules)[i].matches(instance, className, title)) {
+                index = i;
+                break;
+            }
+        }
+    }
+    bool changed = (index != ruleIndex);
+    ruleIndex = index;
+    return changed;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <X11/Xlib.h>
+
+#include <string>
+#include <vector>
+
+#include "EngineConfig.h"
+#include "EventMasks.h"
+
+/*
+Follows the focused window from PropertyNotify events on the root's _NET_ACTIVE_WINDOW, and keeps
+its WM_CLASS and title along with the app rule they match. The properties are only read when the
+focus or the title changes, so finding the rule costs nothing per pointer event.
+*/
+class ActiveWindow {
+  public:
+    // Reads the window focused now, selecting the events it needs in masks. PropertyChangeMask
+    // must be selected on the root beforehand
+    void init(Display *display, Window root, EventMasks *masks, unsigned long *roundTrips);
+
+    // Matches the focused window against new rules. They must stay valid until the next call
+    void setRules(const std::vector<AppRule> *rules);
+
+    // Updates the cache from a PropertyNotify. Returns true if another rule matches now
+    bool handleEvent(const XEvent &ev);
+
+    // Index of the first rule matching the focused window, -1 for none
+    int rule() const { return ruleIndex; }
+
+  private:
+    void readActive();
+    void readProperties();
+    bool matchRule();
+
+    Display *display = nullptr;
+    Window root = None;
+    EventMasks *masks = nullptr;
+    unsigned long *roundTrips = nullptr; // counted along with the backend's
+    Atom atomActiveWindow, atomWmName, atomUtf8String;
+    const std::vector<AppRule> *rules = nullptr;
+
+    Window active = None;
+    std::string instance, className, title;
+    int ruleIndex = -1;
+};
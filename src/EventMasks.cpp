@@ -0,0 +1,19 @@
+#include "EventMasks.h"
+
+void EventMasks::add(Window window, long mask) {
+    long &selected = masks[window];
+    if ((selected | mask) == selected)
+        return;
+    selected |= mask;
+    XSelectInput(display, window, selected);
+}
+
+void EventMasks::remove(Window window, long mask) {
+    auto it = masks.find(window);
+    if (it == masks.end() || (it->second & mask) == 0)
+        return;
+    it->second &= ~mask;
+    XSelectInput(display, window, it->second);
+    if (it->second == 0)
+        masks.erase(it);
+}
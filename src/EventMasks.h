@@ -0,0 +1,25 @@
+#pragma once
+
+#include <X11/Xlib.h>
+
+#include <unordered_map>
+
+/*
+The events selected on each window, for all parts of the program that select some. XSelectInput
+replaces everything a client selected on a window, so the parts add and remove only their own bits
+here, and the union of them is what gets selected.
+*/
+class EventMasks {
+  public:
+    void init(Display *newDisplay) { display = newDisplay; }
+
+    void add(Window window, long mask);
+    void remove(Window window, long mask);
+
+    // The window was destroyed, its selection went with it
+    void forget(Window window) { masks.erase(window); }
+
+  private:
+    Display *display = nullptr;
+    std::unordered_map<Window, long> masks;
+};
@@ -0,0 +1,123 @@
+#include "InputThread.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "Log.h"
+
+bool InputThread::start(int newWakeFD) {
+    wakeFD = newWakeFD;
+
+    if ((display = XOpenDisplay(NULL)) == NULL) {
+        LOG_ERROR("Cannot open a second Display for the input thread");
+        return false;
+    }
+
+    // Every connection has to announce its XInput version before selecting events
+    int ev, err, major = 2, minor = 2;
+    if (!XQueryExtension(display, "XInputExtension", &xiOpcode, &ev, &err) ||
+        XIQueryVersion(display, &major, &minor) != Success) {
+        LOG_ERROR("XInput is not available to the input thread");
+        XCloseDisplay(display);
+        display = nullptr;
+        return false;
+    }
+
+    // Raw motion, and changes to the devices, which may change how to read it
+    Window root = DefaultRootWindow(display);
+    XIEventMask masks[2];
+    unsigned char mask[(XI_LASTEVENT + 7) / 8];
+    unsigned char deviceMask[(XI_LASTEVENT + 7) / 8];
+    memset(mask, 0, sizeof(mask));
+    memset(deviceMask, 0, sizeof(deviceMask));
+    XISetMask(mask, XI_RawMotion);
+    XISetMask(deviceMask, XI_HierarchyChanged);
+    XISetMask(deviceMask, XI_DeviceChanged);
+    masks[0].deviceid = XIAllMasterDevices;
+    masks[0].mask_len = sizeof(mask);
+    masks[0].mask = mask;
+    masks[1].deviceid = XIAllDevices;
+    masks[1].mask_len = sizeof(deviceMask);
+    masks[1].mask = deviceMask;
+    XISelectEvents(display, root, masks, 2);
+    // ConfigureNotify on the root tells when the screen is resized
+    XSelectInput(display, root, StructureNotifyMask);
+    devices.update(display, root, nullptr);
+
+    stopFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFD == -1) {
+        LOG_ERROR("Error in eventfd() for the input thread");
+        XCloseDisplay(display);
+        display = nullptr;
+        return false;
+    }
+
+    thread = std::thread(&InputThread::run, this);
+    return true;
+}
+
+void InputThread::stop() {
+    if (!thread.joinable())
+        return;
+    uint64_t one = 1;
+    if (write(stopFD, &one, sizeof(one)) != sizeof(one))
+        LOG_ERROR("Cannot stop the input thread");
+    thread.join();
+    close(stopFD);
+    stopFD = -1;
+    XCloseDisplay(display);
+    display = nullptr;
+}
+
+void InputThread::run() {
+    pollfd fds[2] = {{ConnectionNumber(display), POLLIN, 0}, {stopFD, POLLIN, 0}};
+    XEvent xevent;
+    while (true) {
+        // Take everything that arrived, then wake the consumer once for all of it
+        bool pushed = false;
+        while (XPending(display)) {
+            XNextEvent(display, &xevent);
+            if (xevent.type == ConfigureNotify) {
+                devices.update(display, DefaultRootWindow(display), nullptr);
+                continue;
+            }
+            XGenericEventCookie *cookie = &xevent.xcookie;
+            if (xevent.type != GenericEvent || cookie->extension != xiOpcode ||
+                !XGetEventData(display, cookie))
+                continue;
+            if (cookie->evtype == XI_RawMotion) {
+                XIRawEvent *motionEvent = (XIRawEvent *)cookie->data;
+                double dx, dy;
+                bool absolute = devices.rawDeltas(motionEvent, &dx, &dy);
+                InputSample sample{motionEvent->deviceid, motionEvent->time, (float)dx, (float)dy,
+                                   absolute, {}};
+                if (timestamps.load(std::memory_order_relaxed))
+                    sample.received = Stats::Clock::now();
+                if (ring.push(sample))
+                    pushed = true;
+                else
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+            } else if (cookie->evtype == XI_HierarchyChanged ||
+                       (cookie->evtype == XI_DeviceChanged &&
+                        ((XIDeviceChangedEvent *)cookie->data)->reason == XIDeviceChange)) {
+                devices.update(display, DefaultRootWindow(display), nullptr);
+            }
+            XFreeEventData(display, cookie);
+        }
+        if (pushed) {
+            uint64_t one = 1;
+            if (write(wakeFD, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+                LOG_ERROR("Cannot wake the decision thread");
+        }
+
+        if (poll(fds, 2, -1) == -1 && errno != EINTR) {
+            LOG_ERROR("Error in poll() in the input thread. Stopping it...");
+            break;
+        }
+        if (fds[1].revents & POLLIN)
+            break;
+    }
+}
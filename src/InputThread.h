@@ -0,0 +1,54 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+#include <atomic>
+#include <thread>
+
+#include "PointerDevices.h"
+#include "SpscRing.h"
+#include "Stats.h"
+
+// Raw motion of one event, as read by the input thread
+struct InputSample {
+    int deviceid;
+    Time time;
+    float dx, dy;
+    bool absolute;                     // from an absolute device, the deltas are estimated
+    Stats::Clock::time_point received; // only set while timestamps are wanted
+};
+
+/*
+Reads raw motion on its own connection to the server, in its own thread, so that no slow work on
+the other threads ever delays taking events off the socket. The samples are passed on through a
+lock-free ring, and the given eventfd is written whenever new ones are in.
+*/
+class InputThread {
+  public:
+    static const size_t capacity = 4096; // samples, seconds of motion even at high rates
+
+    ~InputThread() { stop(); }
+
+    bool start(int wakeFD);
+    void stop();
+
+    // Called from the consuming thread only
+    bool pop(InputSample *sample) { return ring.pop(sample); }
+    // Samples lost because the ring was full, since the last call
+    unsigned long takeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+
+    std::atomic<bool> timestamps{false};
+
+  private:
+    void run();
+
+    Display *display = nullptr;
+    int xiOpcode = 0;
+    PointerDevices devices;
+    int wakeFD = -1;
+    int stopFD = -1;
+    std::thread thread;
+    SpscRing<InputSample, capacity> ring;
+    std::atomic<unsigned long> dropped{0};
+};
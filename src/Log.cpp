@@ -0,0 +1,145 @@
+#include "Log.h"
+
+#include <stdio.h>
+
+AsyncLog asyncLog;
+
+namespace {
+
+FILE *streamFor(LogLevel level) { return level >= LogWarning ? stderr : stdout; }
+
+} // namespace
+
+AsyncLog::AsyncLog() {
+    for (size_t i = 0; i < capacity; i++)
+        lines[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+void AsyncLog::start() {
+    if (running)
+        return;
+    running = true;
+    thread = std::thread(&AsyncLog::run, this);
+}
+
+void AsyncLog::stop() {
+    if (!running)
+        return;
+    {
+        // Under the mutex, so the thread can't miss it between checking and waiting
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+/*
+Claims a line, formats into it and marks it written. This is a bounded multi-producer queue: each
+line carries the position it's free for, so claiming one is a compare-and-swap on the head.
+*/
+void AsyncLog::write(LogLevel level, const char *format, va_list args) {
+    if (!running.load(std::memory_order_acquire)) {
+        FILE *stream = streamFor(level);
+        vfprintf(stream, format, args);
+        fputc('\n', stream);
+        fflush(stream);
+        return;
+    }
+
+    size_t pos = head.load(std::memory_order_relaxed);
+    Line *line;
+    while (true) {
+        line = &lines[pos & (capacity - 1)];
+        size_t seq = line->sequence.load(std::memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // Full: the line still holds a message from the previous lap
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    line->level = level;
+    vsnprintf(line->text, lineLength, format, args);
+    line->sequence.store(pos + 1, std::memory_order_release);
+
+    // Wake the thread for the first line after it printed everything, otherwise it's still busy
+    // and finds the line itself. Hurry it up for errors, or before the ring overflows
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t printed = tail.load(std::memory_order_relaxed);
+    if (pos == printed || level >= LogError || pos - printed >= capacity / 2) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+}
+
+void AsyncLog::run() {
+    while (running.load(std::memory_order_acquire)) {
+        drain();
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this] { return !running.load(std::memory_order_relaxed) || pending(); });
+    }
+    drain();
+}
+
+/*
+True if the next line is written or messages were dropped. The fence pairs with the one in
+write(): either the writer sees the advanced tail and wakes the thread, or the thread sees the line.
+*/
+bool AsyncLog::pending() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t pos = tail.load(std::memory_order_relaxed);
+    return lines[pos & (capacity - 1)].sequence.load(std::memory_order_acquire) == pos + 1 ||
+           dropped.load(std::memory_order_relaxed) > 0;
+}
+
+// Prints the lines written so far
+void AsyncLog::drain() {
+    bool any = false;
+    size_t pos = tail.load(std::memory_order_relaxed);
+    while (true) {
+        Line &line = lines[pos & (capacity - 1)];
+        if (line.sequence.load(std::memory_order_acquire) != pos + 1)
+            break;
+        FILE *stream = streamFor(line.level);
+        fputs(line.text, stream);
+        fputc('\n', stream);
+        line.sequence.store(pos + capacity, std::memory_order_release);
+        tail.store(++pos, std::memory_order_relaxed);
+        any = true;
+    }
+
+    unsigned long lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0) {
+        fprintf(stderr, "%lu log messages were dropped\n", lost);
+        any = true;
+    }
+    if (any) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+}
+
+void logMessage(LogLevel level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    asyncLog.write(level, format, args);
+    va_end(args);
+}
+
+bool parseLogLevel(const std::string &name, LogLevel *level) {
+    static const char *const names[] = {"debug", "info", "warning", "error", "off"};
+    for (int i = LogDebug; i <= LogOff; i++) {
+        if (name == names[i]) {
+            *level = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+enum LogLevel { LogDebug, LogInfo, LogWarning, LogError, LogOff };
+
+// Messages below this level are compiled out, e.g. -DSTICKY_LOG_LEVEL=1 drops the debug ones
+#ifndef STICKY_LOG_LEVEL
+#define STICKY_LOG_LEVEL 0
+#endif
+
+/*
+Logging that never waits on the output. Messages are formatted into a fixed ring of lines, which a
+background thread writes out: debug and info to stdout, warnings and errors to stderr. When the
+ring is full, messages are dropped and counted rather than waiting. Any thread can log.
+
+Before start() and after stop(), messages are written directly.
+*/
+class AsyncLog {
+  public:
+    static const size_t capacity = 1024; // lines, a power of two
+    static const size_t lineLength = 240;
+
+    AsyncLog();
+    ~AsyncLog() { stop(); }
+
+    void start();
+    // Writes out everything logged so far and stops the thread
+    void stop();
+
+    bool wants(LogLevel level) const { return level >= minLevel.load(std::memory_order_relaxed); }
+    void write(LogLevel level, const char *format, va_list args);
+
+    std::atomic<int> minLevel{LogInfo};
+
+  private:
+    struct Line {
+        std::atomic<size_t> sequence; // == position when free, position + 1 once written
+        LogLevel level;
+        char text[lineLength];
+    };
+
+    void run();
+    bool pending() const;
+    void drain();
+
+    Line lines[capacity];
+    std::atomic<size_t> head{0}; // next position to write
+    std::atomic<size_t> tail{0}; // next position to print, only advanced by the thread
+    std::atomic<unsigned long> dropped{0};
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+};
+
+extern AsyncLog asyncLog;
+
+void logMessage(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+// "debug", "info", "warning", "error" or "off"
+bool parseLogLevel(const std::string &name, LogLevel *level);
+
+#define LOG_AT(level, ...)                                                                         \
+    do {                                                                                           \
+        if ((level) >= STICKY_LOG_LEVEL && asyncLog.wants(level))                                  \
+            logMessage(level, __VA_ARGS__);                                                        \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogDebug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogInfo, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LogWarning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogError, __VA_ARGS__)
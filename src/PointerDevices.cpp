@@ -0,0 +1,67 @@
+#include "PointerDevices.h"
+
+void PointerDevices::update(Display *display, Window root, unsigned long *roundTrips) {
+    Window rootDummy;
+    int xDummy, yDummy;
+    unsigned int borderDummy, depthDummy;
+    XGetGeometry(display, root, &rootDummy, &xDummy, &yDummy, &screenSize[0], &screenSize[1],
+                 &borderDummy, &depthDummy);
+
+    int count = 0;
+    XIDeviceInfo *info = XIQueryDevice(display, XIAllDevices, &count);
+    if (roundTrips)
+        *roundTrips += 2;
+
+    std::vector<Device> listed;
+    for (int i = 0; i < count; i++) {
+        if (info[i].use != XISlavePointer)
+            continue;
+        Device device;
+        for (int c = 0; c < info[i].num_classes; c++) {
+            if (info[i].classes[c]->type != XIValuatorClass)
+                continue;
+            const XIValuatorClassInfo *valuator = (const XIValuatorClassInfo *)info[i].classes[c];
+            if (valuator->number < 2 && valuator->mode == XIModeAbsolute) {
+                device.absolute = true;
+                device.axes[valuator->number] = Axis{valuator->min, valuator->max, 0.0, false};
+            }
+        }
+        if (info[i].deviceid >= (int)listed.size())
+            listed.resize(info[i].deviceid + 1);
+        listed[info[i].deviceid] = device;
+    }
+    if (info)
+        XIFreeDeviceInfo(info);
+    devices.swap(listed);
+}
+
+/*
+Reads the motion from the first two valuators of a raw event. The values are packed, one for each
+bit set in the mask, and only the axes that changed are in it.
+*/
+bool PointerDevices::rawDeltas(const XIRawEvent *ev, double *dx, double *dy) {
+    Device *device = (ev->sourceid >= 0 && ev->sourceid < (int)devices.size() &&
+                      devices[ev->sourceid].absolute)
+                         ? &devices[ev->sourceid]
+                         : nullptr;
+    double *deltas[2] = {dx, dy};
+    const double *value = ev->valuators.values;
+    *dx = 0.0;
+    *dy = 0.0;
+    for (int i = 0; i < 2 && i < ev->valuators.mask_len * 8; i++) {
+        if (!XIMaskIsSet(ev->valuators.mask, i))
+            continue;
+        if (!device) {
+            *deltas[i] = *value;
+        } else {
+            // Scaled like the server maps the device onto the screen, without its transformation
+            Axis &axis = device->axes[i];
+            if (axis.lastValid && axis.max > axis.min)
+                *deltas[i] = (*value - axis.last) * screenSize[i] / (axis.max - axis.min);
+            axis.last = *value;
+            axis.lastValid = true;
+        }
+        value++;
+    }
+    return device != nullptr;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+#include <vector>
+
+/*
+How to read the raw motion of each slave pointer device. Mice and touchpads report relative motion
+on their first two valuators. Absolute devices, like tablets, touchscreens and the tablet most
+virtual machines emulate, report positions in device units spanning the screen instead, which are
+turned into estimated pixel deltas here. Each connection reading raw motion keeps its own.
+*/
+class PointerDevices {
+  public:
+    // Lists the devices and reads the size of the screen. Needed again when devices are added or
+    // changed, and when the screen is resized. roundTrips is counted if given
+    void update(Display *display, Window root, unsigned long *roundTrips);
+
+    // Reads the motion of a raw event in pixels. Returns true if it came from an absolute device,
+    // whose deltas are only estimated from the change of its position
+    bool rawDeltas(const XIRawEvent *ev, double *dx, double *dy);
+
+  private:
+    struct Axis {
+        double min, max; // the range of the positions, spanning the screen
+        double last;     // the latest position reported
+        bool lastValid;  // false until a position was reported
+    };
+    struct Device {
+        bool absolute = false;
+        Axis axes[2] = {};
+    };
+
+    std::vector<Device> devices; // by device id
+    unsigned int screenSize[2] = {0, 0};
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*
+Holds the latest of a series of immutable snapshots, for one writer thread and one reader thread,
+RCU-style: the writer publishes a new snapshot with a single pointer swap, and the reader gets a
+consistent one without locks. Snapshots are freed by the writer once the reader can't be using
+them anymore.
+*/
+template <typename T> class SnapshotCell {
+  public:
+    // Writer side. Returns the snapshot that is now the latest
+    const T *publish(std::unique_ptr<const T> snapshot) {
+        const T *next = snapshot.get();
+        owned.push_back(std::move(snapshot));
+        latest.store(next);
+
+        // Anything older than the latest and not announced by the reader can go. If the reader
+        // announces an older one after this, it sees the new one when checking again
+        const T *used = inUse.load();
+        for (size_t i = 0; i < owned.size();) {
+            if (owned[i].get() != next && owned[i].get() != used) {
+                owned[i] = std::move(owned.back());
+                owned.pop_back();
+            } else {
+                i++;
+            }
+        }
+        return next;
+    }
+
+    // Reader side. The snapshot stays valid until the next call
+    const T *current() {
+        const T *snapshot = latest.load();
+        while (true) {
+            inUse.store(snapshot);
+            const T *check = latest.load();
+            if (check == snapshot)
+                return snapshot;
+            snapshot = check;
+        }
+    }
+
+  private:
+    std::atomic<const T *> latest{nullptr};
+    std::atomic<const T *> inUse{nullptr}; // announced by the reader
+    std::vector<std::unique_ptr<const T>> owned; // only touched by the writer
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+
+/*
+Bounded queue between exactly one producer thread and one consumer thread, without locks. Each
+side only writes its own index, and reads the other one to see how far it may go.
+*/
+template <typename T, size_t Capacity> class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "the capacity must be a power of two");
+
+  public:
+    // Producer side. Fails when full
+    bool push(const T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == Capacity) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail == Capacity)
+                return false;
+        }
+        items[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Fails when empty
+    bool pop(T *item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t == cachedHead)
+                return false;
+        }
+        *item = items[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    T items[Capacity];
+
+    // Each index on its own cache line, next to the copy of the other one its side reads
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+};
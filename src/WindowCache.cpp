@@ -0,0 +1,228 @@
+#include "WindowCache.h"
+
+#include <algorithm>
+
+void WindowCache::init(Display *newDisplay, Window newRoot, EventMasks *newMasks) {
+    display = newDisplay;
+    root = newRoot;
+    masks = newMasks;
+    nodes.clear();
+
+    nodes[root] = Node{None, 0, 0, 0, 0, 0, true, {}};
+    isValid = true;
+    addTree(root, None, 0);
+}
+
+void WindowCache::addTree(Window window, Window parent, int depth) {
+    // Select first, so nothing created after the query is missed. The root's mask is up to the
+    // caller, since it might need more events from it
+    if (depth < trackedDepth && window != root)
+        masks->add(window, SubstructureNotifyMask);
+
+    if (window != root) {
+        XWindowAttributes atr;
+        if (!XGetWindowAttributes(display, window, &atr)) {
+            // Already gone
+            return;
+        }
+        addNode(window, parent, atr.x, atr.y, atr.width, atr.height, atr.border_width,
+                atr.map_state != IsUnmapped);
+    }
+
+    if (depth >= trackedDepth)
+        return;
+
+    Window rootDummy, parentDummy, *children;
+    unsigned int nchildren;
+    if (!XQueryTree(display, window, &rootDummy, &parentDummy, &children, &nchildren)) {
+        isValid = false;
+        return;
+    }
+    for (unsigned int i = 0; i < nchildren; i++)
+        addTree(children[i], window, depth + 1);
+    if (children)
+        XFree(children);
+}
+
+void WindowCache::addNode(Window window, Window parent, int x, int y, int w, int h, int border,
+                          bool mapped) {
+    auto parentIt = nodes.find(parent);
+    if (parentIt == nodes.end())
+        return;
+
+    auto it = nodes.find(window);
+    if (it != nodes.end()) {
+        // Already known, e.g. from both the query and a CreateNotify
+        it->second.x = x;
+        it->second.y = y;
+        it->second.w = w;
+        it->second.h = h;
+        it->second.border = border;
+        it->second.mapped = mapped;
+        return;
+    }
+
+    nodes[window] = Node{parent, x, y, w, h, border, mapped, {}};
+    nodes[parent].children.push_back(window); // new windows go on top of their siblings
+}
+
+void WindowCache::removeNode(Window window) {
+    auto it = nodes.find(window);
+    if (it == nodes.end() || window == root)
+        return;
+
+    for (Window child : std::vector<Window>(it->second.children))
+        removeNode(child);
+
+    auto parentIt = nodes.find(it->second.parent);
+    if (parentIt != nodes.end()) {
+        auto &siblings = parentIt->second.children;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), window), siblings.end());
+    }
+    nodes.erase(window);
+}
+
+void WindowCache::restack(Window window, Window above, bool onTop) {
+    auto it = nodes.find(window);
+    if (it == nodes.end())
+        return;
+    auto parentIt = nodes.find(it->second.parent);
+    if (parentIt == nodes.end())
+        return;
+
+    auto &siblings = parentIt->second.children;
+    siblings.erase(std::remove(siblings.begin(), siblings.end(), window), siblings.end());
+
+    if (onTop) {
+        siblings.push_back(window);
+    } else if (above == None) {
+        siblings.insert(siblings.begin(), window);
+    } else {
+        auto aboveIt = std::find(siblings.begin(), siblings.end(), above);
+        if (aboveIt == siblings.end()) {
+            // We lost track of the sibling
+            isValid = false;
+            siblings.push_back(window);
+        } else {
+            siblings.insert(aboveIt + 1, window);
+        }
+    }
+}
+
+int WindowCache::depthOf(Window window) const {
+    int depth = 0;
+    auto it = nodes.find(window);
+    while (it != nodes.end() && it->second.parent != None) {
+        depth++;
+        it = nodes.find(it->second.parent);
+    }
+    return (it == nodes.end()) ? -1 : depth;
+}
+
+void WindowCache::handleEvent(const XEvent &ev) {
+    switch (ev.type) {
+    case CreateNotify: {
+        const XCreateWindowEvent &e = ev.xcreatewindow;
+        if (nodes.count(e.parent) == 0)
+            break;
+        int depth = depthOf(e.parent) + 1;
+        addNode(e.window, e.parent, e.x, e.y, e.width, e.height, e.border_width, false);
+        if (depth < trackedDepth)
+            masks->add(e.window, SubstructureNotifyMask);
+        break;
+    }
+    case DestroyNotify:
+        removeNode(ev.xdestroywindow.window);
+        masks->forget(ev.xdestroywindow.window);
+        break;
+    case ConfigureNotify: {
+        const XConfigureEvent &e = ev.xconfigure;
+        auto it = nodes.find(e.window);
+        if (it == nodes.end())
+            break;
+        it->second.x = e.x;
+        it->second.y = e.y;
+        it->second.w = e.width;
+        it->second.h = e.height;
+        it->second.border = e.border_width;
+        restack(e.window, e.above, false);
+        break;
+    }
+    case GravityNotify: {
+        auto it = nodes.find(ev.xgravity.window);
+        if (it != nodes.end()) {
+            it->second.x = ev.xgravity.x;
+            it->second.y = ev.xgravity.y;
+        }
+        break;
+    }
+    case MapNotify: {
+        auto it = nodes.find(ev.xmap.window);
+        if (it != nodes.end())
+            it->second.mapped = true;
+        break;
+    }
+    case UnmapNotify: {
+        auto it = nodes.find(ev.xunmap.window);
+        if (it != nodes.end())
+            it->second.mapped = false;
+        break;
+    }
+    case ReparentNotify: {
+        const XReparentEvent &e = ev.xreparent;
+        auto it = nodes.find(e.window);
+        if (it != nodes.end() && it->second.parent == e.parent)
+            break; // Reported by both parents, already handled
+
+        // Keep the subtree if it moved to a window we track, otherwise forget it
+        bool mapped = (it != nodes.end()) && it->second.mapped;
+        removeNode(e.window);
+        if (nodes.count(e.parent) && depthOf(e.parent) + 1 <= trackedDepth) {
+            XWindowAttributes atr;
+            if (XGetWindowAttributes(display, e.window, &atr)) {
+                addNode(e.window, e.parent, e.x, e.y, atr.width, atr.height, atr.border_width,
+                        mapped || atr.map_state != IsUnmapped);
+                if (depthOf(e.parent) + 1 < trackedDepth)
+                    addTree(e.window, e.parent, depthOf(e.parent) + 1);
+            }
+        }
+        break;
+    }
+    case CirculateNotify:
+        restack(ev.xcirculate.window, None, ev.xcirculate.place == PlaceOnTop);
+        break;
+    }
+}
+
+bool WindowCache::windowAt(int rootX, int rootY, Window *window, int *x, int *y) const {
+    if (!isValid)
+        return false;
+
+    // Walk down from the root, taking the topmost child containing the point each time
+    Window current = root;
+    int originX = 0, originY = 0; // inside corner of current, in root coordinates
+    bool descended = true;
+    while (descended) {
+        descended = false;
+        const Node &node = nodes.at(current);
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+            if (ignored.count(*it))
+                continue;
+            const Node &child = nodes.at(*it);
+            int cx = originX + child.x, cy = originY + child.y;
+            if (child.mapped && rootX >= cx && rootX < cx + child.w + 2 * child.border &&
+                rootY >= cy && rootY < cy + child.h + 2 * child.border) {
+                current = *it;
+                originX = cx + child.border;
+                originY = cy + child.border;
+                descended = true;
+                break;
+            }
+        }
+    }
+
+    *window = current;
+    *x = rootX - originX;
+    *y = rootY - originY;
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <X11/Xlib.h>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "EventMasks.h"
+
+/*
+Local copy of the window tree near the root: the top-level windows and their children, which is
+where window managers put the client windows. It's kept up to date from SubstructureNotify events,
+so finding the window under the pointer needs no round-trips to the server.
+*/
+class WindowCache {
+  public:
+    // Reads the tree from the server and starts tracking it, selecting the events it needs in
+    // masks. SubstructureNotifyMask must be selected on the root beforehand
+    void init(Display *display, Window root, EventMasks *masks);
+
+    // Updates the cache from a structure event. Other events are ignored
+    void handleEvent(const XEvent &ev);
+
+    // Windows that should never be found, like our own input windows
+    void ignore(Window window) { ignored.insert(window); }
+    void unignore(Window window) { ignored.erase(window); }
+
+    // Finds the deepest known mapped window containing the root position, and the position
+    // relative to it. Returns false if the cache can't be trusted
+    bool windowAt(int rootX, int rootY, Window *window, int *x, int *y) const;
+
+    bool valid() const { return isValid; }
+    void invalidate() { isValid = false; }
+
+  private:
+    struct Node {
+        Window parent;
+        int x, y; // outer corner, relative to the parent's inside
+        int w, h;
+        int border;
+        bool mapped;
+        std::vector<Window> children; // in stacking order, bottom first
+    };
+
+    // How many levels below the root we track
+    static const int trackedDepth = 2;
+
+    void addTree(Window window, Window parent, int depth);
+    void addNode(Window window, Window parent, int x, int y, int w, int h, int border, bool mapped);
+    void removeNode(Window window);
+    void restack(Window window, Window above, bool onTop);
+    int depthOf(Window window) const;
+
+    Display *display = nullptr;
+    Window root = None;
+    EventMasks *masks = nullptr;
+    bool isValid = false;
+    std::unordered_map<Window, Node> nodes;
+    std::unordered_set<Window> ignored;
+};
@@ -0,0 +1,366 @@
+#include "X11Backend.h"
+
+#include <X11/Xatom.h>
+#include <sys/timerfd.h>
+
+#include <algorithm>
+
+#include "Log.h"
+
+using namespace std::chrono;
+
+void X11Backend::init(Display *newDisplay, Window newRoot, WindowCache *newWindowCache) {
+    display = newDisplay;
+    root = newRoot;
+    windowCache = newWindowCache;
+    internAtoms();
+
+    int major = 0, minor = 0;
+    roundTrips++;
+    if (XRRQueryVersion(display, &major, &minor))
+        monitorsSupported = major > 1 || (major == 1 && minor >= 5);
+
+    int deviceid;
+    if (XIGetClientPointer(display, None, &deviceid))
+        clientDevice = deviceid;
+}
+
+// A round-trip per atom
+void X11Backend::internAtoms() {
+    roundTrips += 4;
+    atomWmState = XInternAtom(display, "_NET_WM_STATE", true);
+    atomWmStateFullscreen = XInternAtom(display, "_NET_WM_STATE_FULLSCREEN", true);
+    atomWmWindowType = XInternAtom(display, "_NET_WM_WINDOW_TYPE", False);
+    atomWmWindowTypeDesktop = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
+}
+
+Window X11Backend::createMonitorSpanWindow(int x, int y, unsigned int w, unsigned int h) {
+    XSetWindowAttributes atr;
+    atr.override_redirect = true;
+    Window wnd = XCreateWindow(display, root, x, y, w, h,
+                               0,                  // border width
+                               0,                  // depth
+                               InputOnly,          // class (input-only)
+                               0,                  // visual
+                               CWOverrideRedirect, // valuemask
+                               &atr                // attributes
+    );
+
+    /*In case the window manager still interferes, make the window fullscreen*/
+    XChangeProperty(display, wnd, atomWmState, XA_ATOM, 32, PropModeReplace,
+                    (unsigned char *)&atomWmStateFullscreen, 1);
+
+    /* Keep the window on the bottom so it's not visible or interactible when shown*/
+    XLowerWindow(display, wnd);
+
+    /*In case this doesn't work due to the window manager, tell the WM to treat the window as a
+     * desktop surface. This shouldn't be an issue since this window won't be shown most of the
+     * time*/
+    XChangeProperty(display, wnd, atomWmWindowType, XA_ATOM, 32, PropModeReplace,
+                    (unsigned char *)&atomWmWindowTypeDesktop, 1);
+
+    return wnd;
+}
+
+/*
+The active RandR monitors, which also covers a monitor tiled from several CRTCs and the ones set up
+with `xrandr --setmonitor`. Two round-trips: the monitors, then the names of all of them together.
+Servers before RandR 1.5 only have the CRTCs.
+*/
+void X11Backend::readMonitors(std::vector<MonitorWindow> *monitors) {
+    if (!monitorsSupported) {
+        readCrtcs(monitors);
+        return;
+    }
+
+    roundTrips++;
+    int count = 0;
+    XRRMonitorInfo *infos = XRRGetMonitors(display, root, True, &count);
+    if (!infos) {
+        LOG_ERROR("Couldn't read the monitors");
+        return;
+    }
+    std::vector<Atom> atoms(count);
+    for (int j = 0; j < count; j++) {
+        const XRRMonitorInfo &info = infos[j];
+        atoms[j] = info.name;
+        monitors->push_back(MonitorWindow{NoMonitor, info.name, info.x, info.y,
+                                          (unsigned)info.width, (unsigned)info.height, None, 0});
+    }
+    XRRFreeMonitors(infos);
+
+    // Profiles in the config refer to monitors by name, which is the output's for automatic ones
+    std::vector<char *> names(count, nullptr);
+    if (count > 0) {
+        roundTrips++;
+        XGetAtomNames(display, atoms.data(), count, names.data());
+    }
+    for (int j = 0; j < count; j++) {
+        if (names[j]) {
+            (*monitors)[j].name = names[j];
+            XFree(names[j]);
+        }
+    }
+}
+
+/*
+The enabled CRTCs with the name of their first output, without ids or windows yet. A round-trip
+per CRTC and per output.
+*/
+void X11Backend::readCrtcs(std::vector<MonitorWindow> *crtcs) {
+    roundTrips++;
+    XRRScreenResources *res = XRRGetScreenResourcesCurrent(display, root);
+
+    // CRTC seems to be a monitor assigned to a rectangle of this Screen
+    for (int j = 0; j < res->ncrtc; j++) {
+        roundTrips++;
+        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(display, res, res->crtcs[j]);
+        if (crtc_info->noutput) {
+            MonitorWindow mon{NoMonitor,        res->crtcs[j],     crtc_info->x, crtc_info->y,
+                              crtc_info->width, crtc_info->height, None,         0};
+
+            // Profiles in the config refer to monitors by output name
+            roundTrips++;
+            XRROutputInfo *output = XRRGetOutputInfo(display, res, crtc_info->outputs[0]);
+            if (output) {
+                mon.name = output->name;
+                XRRFreeOutputInfo(output);
+            }
+            crtcs->push_back(mon);
+        }
+        XFree(crtc_info);
+    }
+    XFree(res);
+}
+
+/*
+The caller must release the pointer first, since the confining window may move or disappear.
+*/
+void X11Backend::updateMonitors(int margins, std::vector<Monitor> *monitors) {
+    std::vector<MonitorWindow> newWindows;
+    readMonitors(&newWindows);
+
+    for (MonitorWindow &mon : newWindows) {
+        mon.windowMargins = margins;
+        bool resizeWindow = false;
+
+        // Take over the monitor that was there before
+        for (MonitorWindow &old : windows) {
+            if (old.source == mon.source && old.inputWindow != None) {
+                mon.id = old.id;
+                mon.inputWindow = old.inputWindow;
+                old.inputWindow = None;
+
+                if (old.x != mon.x || old.y != mon.y || old.w != mon.w || old.h != mon.h) {
+                    LOG_INFO("Changed monitor:%3i x:%5i y:%5i w:%4i h:%4i", mon.id, mon.x, mon.y,
+                             mon.w, mon.h);
+                    resizeWindow = true;
+                }
+                if (old.windowMargins != margins)
+                    resizeWindow = true;
+                break;
+            }
+        }
+
+        if (mon.id == NoMonitor) {
+            mon.id = nextMonitorId++;
+            mon.inputWindow = createMonitorSpanWindow(mon.x + margins, mon.y + margins,
+                                                      mon.w - margins * 2, mon.h - margins * 2);
+            windowCache->ignore(mon.inputWindow);
+            LOG_INFO("Found monitor:%3i %s x:%5i y:%5i w:%4i h:%4i, Window %x", mon.id,
+                     mon.name.c_str(), mon.x, mon.y, mon.w, mon.h, (int)mon.inputWindow);
+        } else if (resizeWindow) {
+            // The confining area moved
+            XMoveResizeWindow(display, mon.inputWindow, mon.x + margins, mon.y + margins,
+                              mon.w - margins * 2, mon.h - margins * 2);
+        }
+    }
+
+    // Whatever wasn't taken over is gone
+    for (MonitorWindow &old : windows) {
+        if (old.inputWindow != None) {
+            XDestroyWindow(display, old.inputWindow);
+            windowCache->unignore(old.inputWindow);
+            LOG_INFO("Lost monitor:%3i", old.id);
+        }
+    }
+    windows.swap(newWindows);
+
+    monitors->clear();
+    for (const MonitorWindow &mon : windows)
+        monitors->push_back(Monitor{mon.id, mon.x, mon.y, mon.w, mon.h, mon.name});
+}
+
+void X11Backend::destroyBarriers() {
+    for (PointerBarrier barrier : barriers)
+        XFixesDestroyPointerBarrier(display, barrier);
+    barriers.clear();
+}
+
+/*
+The barriers block the pointer in the server, so there's no need to grab or warp it, and the
+resistance is decided on the barrier hit events.
+*/
+void X11Backend::createBarriers(const MonitorLayout &layout, const std::vector<Monitor> &monitors) {
+    destroyBarriers();
+    if (!useBarriers || !barriersSupported)
+        return;
+
+    // Each shared edge is seen from both monitors, so only take the right and bottom ones
+    for (int i = 0; i < layout.size(); i++) {
+        const Monitor &mon = monitors[i];
+        const MonitorEdges &edges = layout.edgesOf(i);
+
+        for (const EdgeSegment &seg : edges.segments[EdgeRight]) {
+            int x = mon.x + mon.w;
+            if (seg.shared())
+                barriers.push_back(XFixesCreatePointerBarrier(display, root, x, seg.from, x,
+                                                              seg.to, 0, 0, nullptr));
+        }
+        for (const EdgeSegment &seg : edges.segments[EdgeBottom]) {
+            int y = mon.y + mon.h;
+            if (seg.shared())
+                barriers.push_back(XFixesCreatePointerBarrier(display, root, seg.from, y, seg.to,
+                                                              y, 0, 0, nullptr));
+        }
+    }
+    LOG_INFO("Created %i pointer barriers", (int)barriers.size());
+}
+
+void X11Backend::barrierHit(const XIBarrierEvent *ev) {
+    lastEventTime = ev->time;
+    for (BarrierHit &hit : lastBarrierHits) {
+        if (hit.deviceid == ev->deviceid) {
+            hit = BarrierHit{ev->deviceid, ev->barrier, ev->eventid};
+            return;
+        }
+    }
+    lastBarrierHits.push_back(BarrierHit{ev->deviceid, ev->barrier, ev->eventid});
+}
+
+/*
+Asks the server where the pointer is. This is a synchronous round-trip, so the engine only uses it
+to resync its tracked position.
+*/
+void X11Backend::queryPointer(DeviceId device, int *x, int *y) {
+    Window rootDummy, childDummy;
+    double rootX = 0.0, rootY = 0.0, winX, winY;
+    XIButtonState buttons;
+    XIModifierState mods;
+    XIGroupState group;
+    roundTrips++;
+    if (XIQueryPointer(display, device, root, &rootDummy, &childDummy, &rootX, &rootY, &winX,
+                       &winY, &buttons, &mods, &group))
+        XFree(buttons.mask);
+    *x = (int)rootX;
+    *y = (int)rootY;
+}
+
+void X11Backend::warpPointer(DeviceId device, int x, int y) {
+    XIWarpPointer(display, device, None, root, 0, 0, 0, 0, x, y);
+    XFlush(display);
+}
+
+void X11Backend::confine(DeviceId device, const Monitor &mon) {
+    // The barriers already hold the pointer. Other pointers than ours can't be grabbed
+    if (usingBarriers() || pointerConfined != None || device != clientDevice)
+        return;
+
+    for (const MonitorWindow &win : windows) {
+        if (win.id != mon.id)
+            continue;
+
+        // show the (invisible) window so it can grab the pointer
+        XMapWindow(display, win.inputWindow);
+
+        // use the window server to forcefully keep the pointer in the screen,
+        // to prevent flicker
+        roundTrips++;
+        XGrabPointer(display, win.inputWindow, false,
+                     ButtonPressMask | ButtonReleaseMask | PointerMotionMask, GrabModeAsync,
+                     GrabModeAsync, win.inputWindow, None, lastEventTime);
+
+        pointerConfined = win.inputWindow;
+        LOG_DEBUG("Confined pointer to x:%5i y:%5i w:%4i h:%4i, Window %x", win.x, win.y, win.w,
+                  win.h, (int)win.inputWindow);
+        XFlush(display);
+        break;
+    }
+}
+
+void X11Backend::release(DeviceId device) {
+    if (pointerConfined != None && device == clientDevice) {
+        XUngrabPointer(display, lastEventTime);
+        XUnmapWindow(display, pointerConfined);
+        XAllowEvents(display, ReplayPointer, lastEventTime);
+        XFlush(display);
+        pointerConfined = None;
+        LOG_DEBUG("Unconfined pointer");
+    } else if (usingBarriers()) {
+        for (const BarrierHit &hit : lastBarrierHits) {
+            if (hit.deviceid == device) {
+                XIBarrierReleasePointer(display, hit.deviceid, hit.barrier, hit.eventid);
+                XFlush(display);
+                break;
+            }
+        }
+    }
+}
+
+void X11Backend::armDeadline(DeviceId device, duration<float> delay) {
+    steady_clock::time_point when =
+        steady_clock::now() + duration_cast<steady_clock::duration>(delay);
+    bool found = false;
+    for (Deadline &deadline : deadlines) {
+        if (deadline.device == device) {
+            deadline.when = when;
+            found = true;
+        }
+    }
+    if (!found)
+        deadlines.push_back(Deadline{device, when});
+    armPassTimer();
+}
+
+void X11Backend::disarmDeadline(DeviceId device) {
+    for (size_t i = 0; i < deadlines.size(); i++) {
+        if (deadlines[i].device == device) {
+            deadlines[i] = deadlines.back();
+            deadlines.pop_back();
+            armPassTimer();
+            return;
+        }
+    }
+}
+
+bool X11Backend::takeExpiredDeadline(DeviceId *device) {
+    steady_clock::time_point now = steady_clock::now();
+    for (size_t i = 0; i < deadlines.size(); i++) {
+        if (deadlines[i].when <= now) {
+            *device = deadlines[i].device;
+            deadlines[i] = deadlines.back();
+            deadlines.pop_back();
+            return true;
+        }
+    }
+    armPassTimer();
+    return false;
+}
+
+// Sets the timer to the earliest deadline, or disarms it if there is none
+void X11Backend::armPassTimer() {
+    itimerspec when = {};
+    if (!deadlines.empty()) {
+        steady_clock::time_point earliest = deadlines[0].when;
+        for (const Deadline &deadline : deadlines)
+            earliest = std::min(earliest, deadline.when);
+
+        // The steady clock is CLOCK_MONOTONIC. A zero value would disarm the timer
+        long long ns = duration_cast<nanoseconds>(earliest.time_since_epoch()).count();
+        if (ns < 1)
+            ns = 1;
+        when.it_value.tv_sec = ns / 1000000000;
+        when.it_value.tv_nsec = ns % 1000000000;
+    }
+    timerfd_settime(passTimerFD, TFD_TIMER_ABSTIME, &when, nullptr);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrandr.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Backend.h"
+#include "MonitorLayout.h"
+#include "WindowCache.h"
+
+/*
+Backend of the engine on a live X server. The pointer is confined by grabbing it in an invisible
+window spanning the monitor, or held by pointer barriers on the shared edges. Only our client
+pointer can be grabbed; other master pointers are held by the barriers, or warped back by the
+engine.
+*/
+class X11Backend : public Backend {
+  public:
+    void init(Display *display, Window root, WindowCache *windowCache);
+
+    // The master pointer the core events and the grab are about
+    DeviceId clientPointer() const { return clientDevice; }
+
+    // Reads the monitors and applies the differences to the input windows. Monitors keep their id
+    // as long as their RandR monitor, or their CRTC on servers before RandR 1.5, stays
+    void updateMonitors(int resistanceMargins, std::vector<Monitor> *monitors);
+
+    // Places a barrier on every edge shared by two monitors
+    void createBarriers(const MonitorLayout &layout, const std::vector<Monitor> &monitors);
+    void destroyBarriers();
+    bool usingBarriers() const { return !barriers.empty(); }
+
+    // Remembers the hit, needed to release the pointer through the barrier
+    void barrierHit(const XIBarrierEvent *ev);
+
+    // Takes a pointer whose deadline expired, after passTimerFD fired. Rearms the timer for the
+    // remaining ones once none is left
+    bool takeExpiredDeadline(DeviceId *device);
+
+    void queryPointer(DeviceId device, int *x, int *y) override;
+    void warpPointer(DeviceId device, int x, int y) override;
+    void confine(DeviceId device, const Monitor &mon) override;
+    void release(DeviceId device) override;
+    void armDeadline(DeviceId device, std::chrono::duration<float> delay) override;
+    void disarmDeadline(DeviceId device) override;
+
+    bool useBarriers = false;         // barriers were asked for in the config
+    bool barriersSupported = false;   // XFixes 5 and XInput 2.3 are available
+    int passTimerFD = -1;             // fires when the earliest deadline of the pointers expires
+    Time lastEventTime = CurrentTime; // timestamp of the newest pointer event, for the grabs
+    unsigned long roundTrips = 0;     // synchronous requests since the counter was reset
+
+  protected:
+    struct MonitorWindow {
+        MonitorId id;
+        XID source; // the name atom of the RandR monitor, or the CRTC
+        int x, y;
+        unsigned int w, h;
+        Window inputWindow;
+        int windowMargins; // margins the input window was sized with
+        std::string name;  // of the RandR monitor, or of the first output on the CRTC
+    };
+
+    // Requests that a variant of the backend can make another way
+    virtual void internAtoms();
+    virtual void readMonitors(std::vector<MonitorWindow> *monitors);
+    virtual void readCrtcs(std::vector<MonitorWindow> *crtcs);
+
+    void armPassTimer();
+    Window createMonitorSpanWindow(int x, int y, unsigned int w, unsigned int h);
+
+    Display *display = nullptr;
+    Window root = None;
+    DeviceId clientDevice = 2; // the virtual core pointer, unless the server says otherwise
+    bool monitorsSupported = false;     // RandR 1.5 lists the monitors themselves
+    WindowCache *windowCache = nullptr; // must not find our input windows
+    Atom atomWmState, atomWmStateFullscreen, atomWmWindowType, atomWmWindowTypeDesktop;
+
+    std::vector<MonitorWindow> windows;
+    MonitorId nextMonitorId = 0;
+    Window pointerConfined = None; // the window the pointer is grabbed in
+
+  private:
+    std::vector<PointerBarrier> barriers;
+    struct BarrierHit {
+        int deviceid;
+        PointerBarrier barrier;
+        BarrierEventID eventid;
+    };
+    std::vector<BarrierHit> lastBarrierHits; // the latest one of each pointer
+
+    struct Deadline {
+        DeviceId device;
+        std::chrono::steady_clock::time_point when;
+    };
+    std::vector<Deadline> deadlines; // at most one per pointer
+};
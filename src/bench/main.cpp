@@ -0,0 +1,224 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Engine.h"
+#include "FakeBackend.h"
+
+using namespace std::chrono;
+
+/*
+Benchmark of the decision engine's hot path. Runs independent engines on fake backends, side by
+side in one thread, each fed a synthetic stream of raw motion at 1000 Hz of virtual time: strokes
+towards random targets, many of them beyond the edge between two monitors.
+*/
+
+struct Simulation {
+    FakeBackend backend;
+    Engine engine{backend};
+    std::mt19937 rng;
+
+    // The current stroke
+    double targetX = 0.0, targetY = 0.0;
+    double speed = 0.0;  // px/s
+    EventTime strokeEnd; // give up on the target after this
+
+    unsigned long passes = 0;
+};
+
+void newStroke(Simulation &sim) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    sim.targetX = unit(sim.rng) * 3840.0;
+    sim.targetY = unit(sim.rng) * 1080.0;
+    // Aim at the shared edge half of the time, overshooting it like a user would
+    if (unit(sim.rng) < 0.5)
+        sim.targetX = (sim.backend.pointerX < 1920.0 ? 1920.0 : 1919.0) +
+                      (sim.backend.pointerX < 1920.0 ? 1.0 : -1.0) * unit(sim.rng) * 200.0;
+    sim.speed = 200.0 + unit(sim.rng) * 3800.0;
+    sim.strokeEnd =
+        sim.backend.now + duration_cast<EventClock::duration>(duration<double>(unit(sim.rng)));
+}
+
+void step(Simulation &sim, EventTime now, MotionSample *sample) {
+    const double dt = 0.001;
+    if (now > sim.strokeEnd)
+        newStroke(sim);
+
+    double dx = sim.targetX - sim.backend.pointerX, dy = sim.targetY - sim.backend.pointerY;
+    double dist = std::sqrt(dx * dx + dy * dy);
+    double len = std::min(dist, sim.speed * dt);
+    if (dist < 1.0) {
+        newStroke(sim);
+        dx = dy = 0.0;
+    } else {
+        dx = dx / dist * len;
+        dy = dy / dist * len;
+    }
+
+    sim.backend.now = now;
+    sim.backend.move(dx, dy);
+    *sample = MotionSample{now, dx, dy};
+}
+
+/*
+Runs the engines with the given settings and prints the results. Returns the time per event, in
+nanoseconds.
+*/
+double runEngines(const EngineConfig &cfg, int numEngines, long eventsPerEngine, bool withStats) {
+    // ---Set up the engines---
+    const std::vector<Monitor> monitors = {Monitor{0, 0, 0, 1920, 1080},
+                                           Monitor{1, 1920, 0, 1920, 1080}};
+
+    std::vector<Simulation> sims(numEngines);
+    for (int i = 0; i < numEngines; i++) {
+        Simulation &sim = sims[i];
+        sim.rng.seed(i + 1);
+        sim.backend.pointerX = 960.0;
+        sim.backend.pointerY = 540.0;
+        sim.backend.setScreen(monitors, cfg.resistanceMargins);
+        sim.engine.configure(cfg);
+        sim.engine.setMonitors(monitors);
+        sim.engine.stats().enabled = withStats;
+        newStroke(sim);
+    }
+
+    // ---Run---
+    EventTime start = EventTime(seconds(1));
+    MotionSample sample;
+    auto wallStart = steady_clock::now();
+    for (long n = 0; n < eventsPerEngine; n++) {
+        EventTime now = start + milliseconds(n);
+        for (Simulation &sim : sims) {
+            MonitorId before = sim.engine.currentMonitor(sim.backend.device);
+            step(sim, now, &sample);
+            sim.engine.motion(sim.backend.device, &sample, 1);
+            if (sim.backend.takeDeadline(now))
+                sim.engine.deadlineExpired(sim.backend.device);
+            if (sim.engine.currentMonitor(sim.backend.device) != before)
+                sim.passes++;
+        }
+    }
+    duration<double> elapsed = steady_clock::now() - wallStart;
+
+    // ---Report---
+    unsigned long passes = 0, confines = 0, queries = 0;
+    for (const Simulation &sim : sims) {
+        passes += sim.passes;
+        confines += sim.backend.confines;
+        queries += sim.backend.queries;
+    }
+    double events = (double)numEngines * eventsPerEngine;
+    printf("Engines: %i, events: %.0f, time: %.3f s\n", numEngines, events, elapsed.count());
+    printf("Events per second: %.0f, ns per event: %.1f\n", events / elapsed.count(),
+           elapsed.count() * 1e9 / events);
+    printf("Monitor changes: %lu, confines: %lu, pointer queries: %lu\n", passes, confines,
+           queries);
+    if (withStats) {
+        printf("Statistics of the first engine:\n");
+        sims[0].engine.stats().dump(stdout);
+    }
+
+    return elapsed.count() * 1e9 / events;
+}
+
+/*
+Times only what differs between the pass models, on the same recorded motion, as if every sample
+pushed at a right edge: the speeds model's delay from the history speeds that both models keep, and
+the trajectory model's delay along with feeding its filter.
+*/
+void timePassModels(const EngineConfig &cfg, long events) {
+    // ---Record the motion of one simulated pointer---
+    const std::vector<Monitor> monitors = {Monitor{0, 0, 0, 1920, 1080},
+                                           Monitor{1, 1920, 0, 1920, 1080}};
+    Simulation sim;
+    sim.rng.seed(1);
+    sim.backend.pointerX = 960.0;
+    sim.backend.pointerY = 540.0;
+    sim.backend.setScreen(monitors, cfg.resistanceMargins);
+    newStroke(sim);
+    std::vector<MotionSample> samples(events);
+    EventTime start = EventTime(seconds(1));
+    for (long n = 0; n < events; n++)
+        step(sim, start + milliseconds(n), &samples[n]);
+
+    // The inputs of the speeds model, computed the same way for both
+    struct SpeedsInput {
+        float speed1, speed2;
+        PtrSample sample;
+    };
+    std::vector<SpeedsInput> speedsInputs(events);
+    PtrHistory history;
+    history.configure(cfg.ptrInputsToRemember, cfg.ptrRememberFor, cfg.ptrCurrentSpeedFor);
+    for (long n = 0; n < events; n++) {
+        history.push(samples[n].time, samples[n].dx, samples[n].dy);
+        speedsInputs[n] = SpeedsInput{history.windowSpeed(), history.recentSpeed(), history.back()};
+    }
+
+    // ---Time the models---
+    TrajectoryFilter trajectory;
+    double speedsTotal = 0.0, trajectoryTotal = 0.0;
+
+    auto wallStart = steady_clock::now();
+    for (const SpeedsInput &in : speedsInputs)
+        speedsTotal +=
+            Engine::speedDelay(cfg, cfg.edgePass, in.speed1, in.speed2, in.sample, true).count();
+    duration<double> speedsElapsed = steady_clock::now() - wallStart;
+
+    wallStart = steady_clock::now();
+    for (const MotionSample &sample : samples) {
+        trajectory.push(sample.time, sample.dx, sample.dy);
+        trajectoryTotal +=
+            Engine::trajectoryDelay(cfg, cfg.edgePass, trajectory, EdgeRight).count();
+    }
+    duration<double> trajectoryElapsed = steady_clock::now() - wallStart;
+
+    // ---Report---
+    printf("Delay alone, on %li recorded samples:\n", events);
+    printf("  speeds:     %.1f ns per sample, mean delay %.3f s\n",
+           speedsElapsed.count() * 1e9 / events, speedsTotal / events);
+    printf("  trajectory: %.1f ns per sample with the filter update, mean delay %.3f s\n",
+           trajectoryElapsed.count() * 1e9 / events, trajectoryTotal / events);
+}
+
+int main(int argc, char **argv) {
+    // ---Read arguments---
+    int numEngines = (argc >= 2) ? atoi(argv[1]) : 8;
+    long eventsPerEngine = (argc >= 3) ? atol(argv[2]) : 1000000;
+    bool withStats = (argc >= 4) && atoi(argv[3]) != 0;
+    bool gated = (argc >= 5) && atoi(argv[4]) != 0;
+    std::string model = (argc >= 6) ? argv[5] : "speeds";
+    if (numEngines < 1 || eventsPerEngine < 1 ||
+        (model != "speeds" && model != "trajectory" && model != "both")) {
+        fprintf(stderr,
+                "Usage: %s [engines] [events per engine] [stats 0/1] [gate 0/1] "
+                "[speeds/trajectory/both]\n",
+                argv[0]);
+        return -1;
+    }
+
+    EngineConfig cfg;
+    cfg.ptrGateFarFromEdges = gated;
+    if (model != "both") {
+        cfg.passModel = (model == "trajectory") ? PassModelTrajectory : PassModelSpeeds;
+        runEngines(cfg, numEngines, eventsPerEngine, withStats);
+        return 0;
+    }
+
+    // The same strokes with both pass models
+    printf("Pass model: speeds\n");
+    cfg.passModel = PassModelSpeeds;
+    double speedsNs = runEngines(cfg, numEngines, eventsPerEngine, withStats);
+    printf("\nPass model: trajectory\n");
+    cfg.passModel = PassModelTrajectory;
+    double trajectoryNs = runEngines(cfg, numEngines, eventsPerEngine, withStats);
+    printf("\nTrajectory model: %+.1f ns per event (%.2fx the speeds model)\n\n",
+           trajectoryNs - speedsNs, trajectoryNs / speedsNs);
+    timePassModels(cfg, eventsPerEngine);
+
+    return 0;
+}
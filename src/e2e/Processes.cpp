@@ -0,0 +1,138 @@
+#include "Processes.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+bool ChildProcess::start(const std::vector<std::string> &args, const std::vector<std::string> &env,
+                         const std::string &logPath, int keepFD) {
+    int log = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (log == -1) {
+        fprintf(stderr, "Cannot create '%s': %s\n", logPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    child = fork();
+    if (child == -1) {
+        fprintf(stderr, "Error in fork(): %s\n", strerror(errno));
+        close(log);
+        return false;
+    }
+    if (child == 0) {
+        dup2(log, STDOUT_FILENO);
+        dup2(log, STDERR_FILENO);
+        if (keepFD != -1)
+            fcntl(keepFD, F_SETFD, 0);
+        for (const std::string &var : env)
+            putenv(strdup(var.c_str()));
+
+        std::vector<char *> argv;
+        for (const std::string &arg : args)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        fprintf(stderr, "Cannot run '%s': %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+
+    close(log);
+    return true;
+}
+
+void ChildProcess::stop() {
+    if (child <= 0)
+        return;
+
+    kill(child, SIGTERM);
+    for (int i = 0; i < 100; i++) {
+        if (waitpid(child, nullptr, WNOHANG) != 0) {
+            child = -1;
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    child = -1;
+}
+
+bool ChildProcess::running() {
+    if (child <= 0)
+        return false;
+    if (waitpid(child, nullptr, WNOHANG) == 0)
+        return true;
+    child = -1;
+    return false;
+}
+
+double ChildProcess::cpuSeconds() const {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%i/stat", (int)child);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1.0;
+    char buf[1024];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+
+    // The fields after the command, which may contain spaces and parentheses itself
+    const char *fields = strrchr(buf, ')');
+    unsigned long utime, stime;
+    if (!fields || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                          &utime, &stime) != 2)
+        return -1.0;
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+bool startXServer(ChildProcess *server, const std::string &command, const std::string &logPath,
+                  std::string *displayName) {
+    // The server writes the number of the display it picked to this pipe once it's ready
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        fprintf(stderr, "Error in pipe2(): %s\n", strerror(errno));
+        return false;
+    }
+    std::vector<std::string> args;
+    std::istringstream words(command);
+    std::string word;
+    while (words >> word)
+        args.push_back(word);
+    if (args.empty()) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    args.push_back("-displayfd");
+    args.push_back(std::to_string(fds[1]));
+    bool started = server->start(args, {}, logPath, fds[1]);
+    close(fds[1]);
+    if (!started) {
+        close(fds[0]);
+        return false;
+    }
+
+    std::string number;
+    pollfd pfd{fds[0], POLLIN, 0};
+    char c;
+    while (poll(&pfd, 1, 10000) == 1 && read(fds[0], &c, 1) == 1 && c != '\n')
+        number += c;
+    close(fds[0]);
+    if (number.empty()) {
+        fprintf(stderr, "'%s' didn't start, see %s\n", command.c_str(), logPath.c_str());
+        server->stop();
+        return false;
+    }
+    *displayName = ":" + number;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+/*
+A program run by the benchmark, the X server or the daemon under test. It's stopped when the
+object goes away, so no stray server is left behind when the benchmark fails.
+*/
+class ChildProcess {
+  public:
+    ~ChildProcess() { stop(); }
+
+    /*
+    Runs args[0] with the given arguments and extra environment variables ("NAME=value"), with
+    its output going to logPath. keepFD is left open in the child, all other descriptors of ours
+    are closed on exec.
+    */
+    bool start(const std::vector<std::string> &args, const std::vector<std::string> &env,
+               const std::string &logPath, int keepFD = -1);
+
+    // SIGTERM, then SIGKILL if it's still there after a second
+    void stop();
+
+    bool running();
+    pid_t pid() const { return child; }
+
+    // User and system CPU time used so far, in seconds, or -1 if it can't be read
+    double cpuSeconds() const;
+
+  private:
+    pid_t child = -1;
+};
+
+/*
+Starts an X server on a free display: the command, split at spaces, with -displayfd added.
+Returns the display name, e.g. ":1", once the server accepts connections.
+*/
+bool startXServer(ChildProcess *server, const std::string &command, const std::string &logPath,
+                  std::string *displayName);
@@ -0,0 +1,795 @@
+#include <MiIni.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/Xrandr.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EngineConfig.h"
+#include "Processes.h"
+#include "StatsFile.h"
+
+/*
+End-to-end benchmark of the daemon: starts an X server with the given monitor layout, runs
+sticky-mouse-trap on it, and moves the pointer through XTest like a mouse polled at each of the
+given rates. Three scenarios are run per rate:
+
+- sweep: circles in the middle of a monitor, for the throughput and cost of plain motion
+- cross: pushes through a shared edge, for how the pointer is held and let through
+- click: clicks while held at the edge, for whether the click reaches the window under it
+
+The latencies and request counts come from the statistics the daemon publishes, the positions
+from asking the server. Everything is written as JSON.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+struct Head {
+    int x, y, w, h;
+};
+
+// Two monitors touching along a line, one left of or above it, the low side, and one past it
+struct SharedEdge {
+    int axis;        // 0 for a vertical edge, crossed along x, 1 for a horizontal one
+    int pos;         // first coordinate on the high side
+    int along;       // middle of the shared part, on the other axis
+    int alongLength; // length of the shared part
+};
+
+// Builds a JSON object, keeping the fields in the order they're added
+class JsonObject {
+  public:
+    JsonObject &addInt(const char *key, long long value) {
+        return addRaw(key, std::to_string(value));
+    }
+    JsonObject &addFloat(const char *key, double value) {
+        char buf[32];
+        if (!isfinite(value))
+            snprintf(buf, sizeof(buf), "null");
+        else
+            snprintf(buf, sizeof(buf), "%.6g", value);
+        return addRaw(key, buf);
+    }
+    JsonObject &addBool(const char *key, bool value) {
+        return addRaw(key, value ? "true" : "false");
+    }
+    JsonObject &addString(const char *key, const std::string &value) {
+        std::string quoted = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            if ((unsigned char)c >= 0x20)
+                quoted += c;
+        }
+        return addRaw(key, quoted + "\"");
+    }
+    JsonObject &addObject(const char *key, const JsonObject &value) {
+        return addRaw(key, value.str());
+    }
+    JsonObject &addArray(const char *key, const std::vector<JsonObject> &values) {
+        std::string array = "[";
+        for (size_t i = 0; i < values.size(); i++)
+            array += (i ? ",\n" : "\n") + values[i].str();
+        return addRaw(key, array + "\n]");
+    }
+
+    std::string str() const { return "{" + fields + "}"; }
+
+  private:
+    JsonObject &addRaw(const char *key, const std::string &json) {
+        if (!fields.empty())
+            fields += ", ";
+        fields += "\"" + std::string(key) + "\": " + json;
+        return *this;
+    }
+
+    std::string fields;
+};
+
+/*
+Sends relative motion through XTest at a fixed rate, like a mouse polled at that rate. The motion
+is accumulated, so directions that aren't whole pixels per event come out right on average.
+*/
+class Mouse {
+  public:
+    Mouse(Display *display, double rate) : display(display) {
+        std::chrono::duration<double> seconds(1.0 / rate);
+        period = std::chrono::duration_cast<Clock::duration>(seconds);
+        restart();
+    }
+
+    // The next event is sent right away, e.g. after a pause
+    void restart() { next = Clock::now(); }
+
+    // Waits for the next poll and sends the motion since the last one
+    void move(double dx, double dy) {
+        std::this_thread::sleep_until(next);
+        next += period;
+        restX += dx;
+        restY += dy;
+        int ix = (int)lround(restX), iy = (int)lround(restY);
+        restX -= ix;
+        restY -= iy;
+        XTestFakeRelativeMotionEvent(display, ix, iy, CurrentTime);
+        XFlush(display);
+        sent++;
+    }
+
+    void click() {
+        XTestFakeButtonEvent(display, 1, True, CurrentTime);
+        XTestFakeButtonEvent(display, 1, False, CurrentTime);
+        XFlush(display);
+    }
+
+    long long sent = 0;
+
+  private:
+    Display *display;
+    Clock::duration period;
+    Clock::time_point next;
+    double restX = 0.0, restY = 0.0;
+};
+
+struct Options {
+    std::string daemonPath = "sticky-mouse-trap";
+    std::string serverCommand; // Xvfb sized to the layout when empty
+    std::string basePath;      // config of the daemon, the defaults when empty
+    std::vector<double> rates = {125.0, 1000.0, 8000.0};
+    int events = 5000;
+    int crossings = 20;
+    int clicks = 10;
+    std::vector<Head> heads = {{0, 0, 1920, 1080}, {1920, 0, 1920, 1080}};
+    std::string layout = "1920x1080+0+0,1920x1080+1920+0";
+    double speed = 2000.0; // pixels per second
+    std::string outputPath;
+};
+
+// The test's state: the server, the daemon and what's needed to talk to them
+struct Session {
+    Options opt;
+    std::string tmpDir;
+    Display *display = nullptr;
+    Window root = None;
+    ChildProcess server, daemon;
+    StatsReader stats;
+    EngineConfig engineCfg;
+};
+
+bool parseList(const std::string &text, std::vector<std::string> *items) {
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+        items->push_back(item);
+    return !items->empty();
+}
+
+bool parseLayout(const std::string &text, std::vector<Head> *heads) {
+    std::vector<std::string> items;
+    if (!parseList(text, &items))
+        return false;
+    heads->clear();
+    for (const std::string &item : items) {
+        Head head;
+        char end;
+        if (sscanf(item.c_str(), "%dx%d%d%d%c", &head.w, &head.h, &head.x, &head.y, &end) != 4 ||
+            head.w <= 0 || head.h <= 0 || head.x < 0 || head.y < 0)
+            return false;
+        heads->push_back(head);
+    }
+    return true;
+}
+
+// Finds the first pair of heads that touch, with room for the crossing and click areas
+bool findSharedEdge(const std::vector<Head> &heads, SharedEdge *edge) {
+    for (size_t a = 0; a < heads.size(); a++) {
+        for (size_t b = 0; b < heads.size(); b++) {
+            const Head &l = heads[a], &h = heads[b];
+            if (l.x + l.w == h.x) {
+                int from = std::max(l.y, h.y), to = std::min(l.y + l.h, h.y + h.h);
+                if (to - from >= 100) {
+                    *edge = SharedEdge{0, h.x, (from + to) / 2, to - from};
+                    return true;
+                }
+            }
+            if (l.y + l.h == h.y) {
+                int from = std::max(l.x, h.x), to = std::min(l.x + l.w, h.x + h.w);
+                if (to - from >= 100) {
+                    *edge = SharedEdge{1, h.y, (from + to) / 2, to - from};
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/*
+Lays the screen out as the given heads with RandR 1.5 monitors, which any server can show whatever
+number of CRTCs it has; Xvfb has a single one. The shown outputs are handed to the heads in order,
+the last head taking the rest, so the server drops the monitors it made for them. The screen must
+already cover all heads.
+*/
+bool setHeads(Display *display, Window root, const std::vector<Head> &heads) {
+    int major = 0, minor = 0;
+    if (!XRRQueryVersion(display, &major, &minor) || (major == 1 && minor < 5)) {
+        fprintf(stderr, "The X server has RandR %i.%i, the monitors need 1.5\n", major, minor);
+        return false;
+    }
+    int width = 0, height = 0;
+    for (const Head &head : heads) {
+        width = std::max(width, head.x + head.w);
+        height = std::max(height, head.y + head.h);
+    }
+    XWindowAttributes rootAttributes;
+    XGetWindowAttributes(display, root, &rootAttributes);
+    if (rootAttributes.width < width || rootAttributes.height < height) {
+        fprintf(stderr, "The screen is %ix%i, the layout needs %ix%i\n", rootAttributes.width,
+                rootAttributes.height, width, height);
+        return false;
+    }
+
+    // An output belongs to one monitor at most
+    std::vector<RROutput> outputs;
+    if (XRRScreenResources *res = XRRGetScreenResourcesCurrent(display, root)) {
+        for (int i = 0; i < res->ncrtc; i++) {
+            XRRCrtcInfo *info = XRRGetCrtcInfo(display, res, res->crtcs[i]);
+            if (info && info->noutput)
+                outputs.push_back(info->outputs[0]);
+            if (info)
+                XRRFreeCrtcInfo(info);
+        }
+        XRRFreeScreenResources(res);
+    }
+
+    for (size_t i = 0; i < heads.size(); i++) {
+        const Head &head = heads[i];
+        std::vector<RROutput> headOutputs;
+        for (size_t o = 0; o < outputs.size(); o++)
+            if (std::min(o, heads.size() - 1) == i)
+                headOutputs.push_back(outputs[o]);
+
+        XRRMonitorInfo *mon = XRRAllocateMonitor(display, (int)headOutputs.size());
+        const std::string name = "E2E-" + std::to_string(i);
+        mon->name = XInternAtom(display, name.c_str(), False);
+        mon->primary = (i == 0);
+        mon->automatic = False;
+        mon->x = head.x;
+        mon->y = head.y;
+        mon->width = head.w;
+        mon->height = head.h;
+        mon->mwidth = head.w * 254 / 960;
+        mon->mheight = head.h * 254 / 960;
+        std::copy(headOutputs.begin(), headOutputs.end(), mon->outputs);
+        XRRSetMonitor(display, root, mon);
+        XRRFreeMonitors(mon);
+    }
+
+    int count = 0;
+    XRRMonitorInfo *monitors = XRRGetMonitors(display, root, True, &count);
+    if (monitors)
+        XRRFreeMonitors(monitors);
+    if (count != (int)heads.size()) {
+        fprintf(stderr, "The X server shows %i monitors, the layout has %i\n", count,
+                (int)heads.size());
+        return false;
+    }
+    return true;
+}
+
+/*
+Writes the daemon's config: the base config with the statistics enabled, which the benchmark
+reads the latencies and counters from.
+*/
+bool writeDaemonConfig(const std::string &basePath, const std::string &path) {
+    std::ofstream out(path);
+    if (basePath != "") {
+        std::ifstream in(basePath);
+        if (!in) {
+            fprintf(stderr, "Cannot read '%s'\n", basePath.c_str());
+            return false;
+        }
+        std::string line;
+        bool skipping = false;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line[0] == '[')
+                skipping = (line.compare(0, 12, "[Statistics]") == 0);
+            if (!skipping)
+                out << line << "\n";
+        }
+    }
+    out << "\n[Statistics]\nEnabled=true\n";
+    return (bool)out;
+}
+
+// The counters and histograms added between two reads of the statistics. The maxima stay overall
+StatsData statsSince(const StatsData &before, const StatsData &after) {
+    StatsData d = after;
+    for (int c = 0; c < StatCounterCount; c++)
+        d.counters[c] -= before.counters[c];
+    for (int s = 0; s < StatStageCount; s++) {
+        for (int b = 0; b < LatencyHistogram::bucketCount; b++)
+            d.stages[s].buckets[b] -= before.stages[s].buckets[b];
+        d.stages[s].count -= before.stages[s].count;
+        d.stages[s].sum -= before.stages[s].sum;
+    }
+    return d;
+}
+
+/*
+Reads the statistics once the daemon published its round-trips, which it adds on its
+one-second tick.
+*/
+bool settledStats(Session *s, StatsData *data) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    for (int tries = 0; tries < 10; tries++) {
+        if (s->stats.read(data))
+            return true;
+    }
+    fprintf(stderr, "The statistics kept changing while being read\n");
+    return false;
+}
+
+// Latencies of a stage, in microseconds
+JsonObject latencyJson(const LatencyHistogram &h) {
+    JsonObject o;
+    o.addInt("count", (long long)h.count);
+    o.addFloat("p50_us", h.count ? h.percentile(0.5) / 1000.0 : NAN);
+    o.addFloat("p99_us", h.count ? h.percentile(0.99) / 1000.0 : NAN);
+    o.addFloat("max_us", h.count ? h.max / 1000.0 : NAN);
+    return o;
+}
+
+// What the daemon did during a scenario
+JsonObject daemonJson(const StatsData &d) {
+    JsonObject o;
+    o.addInt("raw_events", (long long)d.counters[StatRawEvents]);
+    o.addInt("motion_batches", (long long)d.counters[StatMotionBatches]);
+    o.addInt("gated_batches", (long long)d.counters[StatGatedBatches]);
+    o.addInt("confines", (long long)d.counters[StatConfines]);
+    o.addInt("releases", (long long)d.counters[StatReleases]);
+    o.addInt("passes", (long long)d.counters[StatPasses]);
+    o.addInt("round_trips", (long long)d.counters[StatRoundTrips]);
+    o.addObject("latency", latencyJson(d.stages[StageLatency]));
+    o.addObject("decision", latencyJson(d.stages[StageDecision]));
+    o.addObject("confine", latencyJson(d.stages[StageConfine]));
+    return o;
+}
+
+void pointerPosition(Session *s, int *x, int *y) {
+    Window rootDummy, childDummy;
+    int winX, winY;
+    unsigned int mask;
+    XQueryPointer(s->display, s->root, &rootDummy, &childDummy, x, y, &winX, &winY, &mask);
+}
+
+// Moves the pointer without raw motion, then waits until the daemon noticed
+void placePointer(Session *s, int x, int y) {
+    XWarpPointer(s->display, None, s->root, 0, 0, 0, 0, x, y);
+    XSync(s->display, False);
+    std::this_thread::sleep_for(s->engineCfg.ptrResyncInterval + std::chrono::milliseconds(100));
+}
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/*
+Circles in the middle of the first head, which is plain motion without any decision to make.
+Gives the event rate the daemon keeps up with and its cost per event.
+*/
+bool runSweep(Session *s, double rate, JsonObject *result) {
+    const Head &head = s->opt.heads[0];
+    const double step = std::max(1.0, s->opt.speed / rate);
+    const double radius = std::min(head.w, head.h) / 4.0;
+    const int cx = head.x + head.w / 2, cy = head.y + head.h / 2;
+    placePointer(s, cx + (int)radius, cy);
+
+    StatsData before, after;
+    if (!s->stats.read(&before))
+        return false;
+    double cpuBefore = s->daemon.cpuSeconds();
+
+    Mouse mouse(s->display, rate);
+    double angle = 0.0, x = radius, y = 0.0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < s->opt.events; i++) {
+        angle += step / radius;
+        double nx = radius * cos(angle), ny = radius * sin(angle);
+        mouse.move(nx - x, ny - y);
+        x = nx;
+        y = ny;
+    }
+    XSync(s->display, False);
+    double seconds = msSince(start) / 1000.0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    double cpu = s->daemon.cpuSeconds() - cpuBefore;
+
+    int finalX, finalY;
+    pointerPosition(s, &finalX, &finalY);
+    if (!settledStats(s, &after))
+        return false;
+    StatsData d = statsSince(before, after);
+
+    result->addInt("events", mouse.sent);
+    result->addFloat("seconds", seconds);
+    result->addFloat("events_per_second", mouse.sent / seconds);
+    result->addFloat("daemon_cpu_ms_per_1000_events", cpu * 1e6 / mouse.sent);
+    result->addFloat("round_trips_per_1000_events",
+                     d.counters[StatRoundTrips] * 1000.0 / mouse.sent);
+    result->addInt("expected_x", cx + lround(x));
+    result->addInt("expected_y", cy + lround(y));
+    result->addInt("final_x", finalX);
+    result->addInt("final_y", finalY);
+    result->addObject("daemon", daemonJson(d));
+    return true;
+}
+
+/*
+Pushes the pointer through the shared edge, both ways in turn, asking the server where it is after
+every event. The time it reaches the edge is known from the distance moved; from then on, every
+sample on the far side before the pointer is finally let through is flicker, which the confinement
+should prevent.
+*/
+bool runCross(Session *s, const SharedEdge &edge, double rate, JsonObject *result) {
+    const double step = std::max(1.0, s->opt.speed / rate);
+    const int approach = 200; // pixels from the start to the edge
+    const int maxEvents = (int)(rate * 3.0);
+
+    StatsData before, after;
+    if (!s->stats.read(&before))
+        return false;
+
+    std::vector<double> passDelays;
+    int passed = 0, flickers = 0, finalX = 0, finalY = 0;
+    double flickerMs = 0.0;
+    Mouse mouse(s->display, rate);
+    for (int c = 0; c < s->opt.crossings; c++) {
+        const int dir = (c % 2 == 0) ? 1 : -1;
+        const int startPos = (dir > 0) ? edge.pos - approach : edge.pos + approach - 1;
+        if (edge.axis == 0)
+            placePointer(s, startPos, edge.along);
+        else
+            placePointer(s, edge.along, startPos);
+
+        const int contactEvent = (int)ceil((approach - 1) / step);
+        Clock::time_point start = Clock::now(), contact = start, lastFar = start;
+        bool far = false, crossed = false;
+        mouse.restart();
+        for (int i = 0; i < maxEvents; i++) {
+            mouse.move(edge.axis == 0 ? dir * step : 0.0, edge.axis == 1 ? dir * step : 0.0);
+            pointerPosition(s, &finalX, &finalY);
+            Clock::time_point now = Clock::now();
+            if (i == contactEvent)
+                contact = now;
+
+            const int p = (edge.axis == 0) ? finalX : finalY;
+            const bool past = (dir > 0) ? p >= edge.pos : p < edge.pos;
+            if (past && !far)
+                lastFar = now;
+            if (!past && far) {
+                // Was across, and taken back
+                flickers++;
+                flickerMs += std::chrono::duration<double, std::milli>(now - lastFar).count();
+            }
+            far = past;
+
+            // Let through when well past the edge
+            if (past && abs(p - edge.pos) >= approach / 2) {
+                crossed = true;
+                passDelays.push_back(
+                    std::chrono::duration<double, std::milli>(lastFar - contact).count());
+                break;
+            }
+        }
+        if (crossed) {
+            passed++;
+        } else {
+            // Still held: a click lets it go
+            mouse.click();
+            XSync(s->display, False);
+        }
+    }
+    if (!settledStats(s, &after))
+        return false;
+    StatsData d = statsSince(before, after);
+
+    std::sort(passDelays.begin(), passDelays.end());
+    result->addInt("crossings", s->opt.crossings);
+    result->addInt("passed", passed);
+    result->addFloat("pass_delay_p50_ms",
+                     passDelays.empty() ? NAN : passDelays[passDelays.size() / 2]);
+    result->addFloat("pass_delay_max_ms", passDelays.empty() ? NAN : passDelays.back());
+    result->addInt("flickers", flickers);
+    result->addFloat("flicker_ms", flickerMs);
+    result->addInt("final_x", finalX);
+    result->addInt("final_y", finalY);
+    result->addObject("daemon", daemonJson(d));
+    return true;
+}
+
+/*
+Clicks while the pointer is held at the edge of the low head, where a window covers the last
+100 pixels. The daemon grabs the pointer while holding it, so the click only arrives if the daemon
+replays it, and at the right place if it replays it where the pointer is.
+*/
+bool runClick(Session *s, const SharedEdge &edge, double rate, JsonObject *result) {
+    const double step = std::max(1.0, s->opt.speed / rate);
+    const int strip = 100;
+
+    XSetWindowAttributes attrs;
+    attrs.override_redirect = True;
+    attrs.event_mask = ButtonPressMask;
+    const int wx = (edge.axis == 0) ? edge.pos - strip : edge.along - edge.alongLength / 2;
+    const int wy = (edge.axis == 1) ? edge.pos - strip : edge.along - edge.alongLength / 2;
+    const int ww = (edge.axis == 0) ? strip : edge.alongLength;
+    const int wh = (edge.axis == 1) ? strip : edge.alongLength;
+    Window window = XCreateWindow(s->display, s->root, wx, wy, ww, wh, 0, CopyFromParent, InputOnly,
+                                  CopyFromParent, CWOverrideRedirect | CWEventMask, &attrs);
+    XMapRaised(s->display, window);
+    XSync(s->display, False);
+
+    int held = 0, delivered = 0, misplaced = 0, lost = 0;
+    Mouse mouse(s->display, rate);
+    for (int c = 0; c < s->opt.clicks; c++) {
+        // Into the strip, then on against the edge for a while, less than it takes to pass
+        if (edge.axis == 0)
+            placePointer(s, edge.pos - strip / 2, edge.along);
+        else
+            placePointer(s, edge.along, edge.pos - strip / 2);
+        mouse.restart();
+        const int pushEvents = (int)ceil(strip / 2 / step) + (int)(rate * 0.02);
+        for (int i = 0; i < pushEvents; i++)
+            mouse.move(edge.axis == 0 ? step : 0.0, edge.axis == 1 ? step : 0.0);
+
+        int x, y;
+        pointerPosition(s, &x, &y);
+        if (((edge.axis == 0) ? x : y) < edge.pos)
+            held++;
+        mouse.click();
+
+        // Take what arrives within a while
+        int presses = 0;
+        Clock::time_point start = Clock::now();
+        while (msSince(start) < 200.0) {
+            while (XPending(s->display)) {
+                XEvent ev;
+                XNextEvent(s->display, &ev);
+                if (ev.type != ButtonPress)
+                    continue;
+                presses++;
+                if (ev.xbutton.x_root < wx || ev.xbutton.x_root >= wx + ww ||
+                    ev.xbutton.y_root < wy || ev.xbutton.y_root >= wy + wh)
+                    misplaced++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (presses == 0)
+            lost++;
+        delivered += presses;
+    }
+    XDestroyWindow(s->display, window);
+    XSync(s->display, False);
+
+    result->addInt("clicks", s->opt.clicks);
+    result->addInt("held", held);
+    result->addInt("delivered", delivered);
+    result->addInt("lost", lost);
+    result->addInt("misplaced", misplaced);
+    return true;
+}
+
+void cleanup(Session *s) {
+    s->stats.close();
+    s->daemon.stop();
+    if (s->display)
+        XCloseDisplay(s->display);
+    s->display = nullptr;
+    s->server.stop();
+    if (s->tmpDir != "") {
+        std::string command = "rm -rf '" + s->tmpDir + "'";
+        if (system(command.c_str()) != 0)
+            fprintf(stderr, "Cannot remove %s\n", s->tmpDir.c_str());
+    }
+}
+
+int main(int argc, char **argv) {
+    // ---Read arguments---
+    Session s;
+    Options &opt = s.opt;
+    bool badArgs = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            badArgs = true;
+            break;
+        }
+        std::string value = argv[++i];
+        if (arg == "-d")
+            opt.daemonPath = value;
+        else if (arg == "-x")
+            opt.serverCommand = value;
+        else if (arg == "-c")
+            opt.basePath = value;
+        else if (arg == "-r") {
+            std::vector<std::string> items;
+            opt.rates.clear();
+            badArgs |= !parseList(value, &items);
+            for (const std::string &item : items)
+                opt.rates.push_back(atof(item.c_str()));
+        } else if (arg == "-n")
+            opt.events = atoi(value.c_str());
+        else if (arg == "-k")
+            opt.crossings = atoi(value.c_str());
+        else if (arg == "-m")
+            opt.clicks = atoi(value.c_str());
+        else if (arg == "-l") {
+            opt.layout = value;
+            badArgs |= !parseLayout(value, &opt.heads);
+        } else if (arg == "-v")
+            opt.speed = atof(value.c_str());
+        else if (arg == "-o")
+            opt.outputPath = value;
+        else
+            badArgs = true;
+    }
+    for (double rate : opt.rates)
+        badArgs |= !(rate > 0.0);
+    if (badArgs || opt.events <= 0 || opt.crossings < 0 || opt.clicks < 0 || !(opt.speed > 0.0)) {
+        fprintf(stderr,
+                "Usage: %s [-d daemon] [-x X server command] [-c config] [-r rates in Hz, e.g. "
+                "125,1000,8000]\n"
+                "       [-n sweep events] [-k crossings] [-m clicks] [-l layout, e.g. "
+                "1920x1080+0+0,1920x1080+1920+0]\n"
+                "       [-v speed in pixels per second] [-o results.json]\n",
+                argv[0]);
+        return -1;
+    }
+    int width = 0, height = 0;
+    for (const Head &head : opt.heads) {
+        width = std::max(width, head.x + head.w);
+        height = std::max(height, head.y + head.h);
+    }
+    if (opt.serverCommand == "")
+        opt.serverCommand = "Xvfb -screen 0 " + std::to_string(width) + "x" +
+                            std::to_string(height) + "x24 -nolisten tcp +extension RANDR";
+
+    // ---Load config---
+    if (opt.basePath != "") {
+        try {
+            MiIni<std::string> config;
+            config.open(opt.basePath, false);
+            readEngineConfig(config, &s.engineCfg);
+        } catch (const MiIni<>::FileError &e) {
+            fprintf(stderr, "Cannot read '%s': %s\n", opt.basePath.c_str(), e.what());
+            return -1;
+        }
+    }
+
+    // ---Temporary directory---
+    // Holds the config, the statistics and the logs, so nothing of the user's is touched
+    char dirTemplate[] = "/tmp/sticky-mouse-trap-e2e.XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        fprintf(stderr, "Cannot create a temporary directory\n");
+        return -1;
+    }
+    s.tmpDir = dirTemplate;
+    const std::string cfgPath = s.tmpDir + "/sticky-mouse-trap.cfg";
+    if (!writeDaemonConfig(opt.basePath, cfgPath)) {
+        cleanup(&s);
+        return -1;
+    }
+
+    // ---Start the X server---
+    std::string displayName;
+    if (!startXServer(&s.server, opt.serverCommand, s.tmpDir + "/server.log", &displayName)) {
+        cleanup(&s);
+        return -1;
+    }
+    s.display = XOpenDisplay(displayName.c_str());
+    int event, error, major, minor;
+    if (!s.display || !XTestQueryExtension(s.display, &event, &error, &major, &minor) ||
+        !XRRQueryExtension(s.display, &event, &error)) {
+        fprintf(stderr, "Cannot use the X server on %s, or it lacks XTest or RandR\n",
+                displayName.c_str());
+        cleanup(&s);
+        return -1;
+    }
+    s.root = DefaultRootWindow(s.display);
+
+    // ---Set up the heads---
+    if (!setHeads(s.display, s.root, opt.heads)) {
+        cleanup(&s);
+        return -1;
+    }
+    SharedEdge edge;
+    const bool haveEdge = findSharedEdge(opt.heads, &edge);
+    if (!haveEdge)
+        fprintf(stderr, "No heads share an edge, only sweeping\n");
+    // Relative motion moves by exactly what's sent
+    XChangePointerControl(s.display, True, True, 1, 1, 0);
+    XSync(s.display, False);
+
+    // ---Start the daemon---
+    if (!s.daemon.start({opt.daemonPath, cfgPath},
+                        {"DISPLAY=" + displayName, "XDG_RUNTIME_DIR=" + s.tmpDir},
+                        s.tmpDir + "/daemon.log")) {
+        cleanup(&s);
+        return -1;
+    }
+    const std::string statsPath = s.tmpDir + "/sticky-mouse-trap.stats";
+    std::string statsError;
+    bool statsOpen = false;
+    for (int tries = 0; tries < 100 && !statsOpen; tries++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        statsOpen = s.stats.open(statsPath, &statsError);
+    }
+    if (!statsOpen || !s.daemon.running() || s.stats.header().pid != s.daemon.pid()) {
+        fprintf(stderr, "The daemon didn't start: %s\n", statsError.c_str());
+        cleanup(&s);
+        return -1;
+    }
+    // Done with finding the monitors
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    // ---Run---
+    std::vector<JsonObject> runs;
+    for (double rate : opt.rates) {
+        printf("%g Hz...\n", rate);
+        fflush(stdout);
+        JsonObject run, sweep, cross, click;
+        run.addFloat("rate_hz", rate);
+        if (!runSweep(&s, rate, &sweep)) {
+            cleanup(&s);
+            return -1;
+        }
+        run.addObject("sweep", sweep);
+        if (haveEdge) {
+            if (!runCross(&s, edge, rate, &cross) || !runClick(&s, edge, rate, &click)) {
+                cleanup(&s);
+                return -1;
+            }
+            run.addObject("cross", cross);
+            run.addObject("click", click);
+        }
+        runs.push_back(run);
+    }
+    const bool daemonAlive = s.daemon.running();
+
+    // ---Write results---
+    JsonObject results;
+    results.addString("layout", opt.layout);
+    results.addString("server", opt.serverCommand);
+    results.addFloat("speed_px_per_s", opt.speed);
+    results.addBool("daemon_survived", daemonAlive);
+    results.addArray("runs", runs);
+    std::string json = results.str() + "\n";
+    if (opt.outputPath != "") {
+        std::ofstream out(opt.outputPath);
+        out << json;
+        if (!out) {
+            fprintf(stderr, "Cannot write '%s'\n", opt.outputPath.c_str());
+            cleanup(&s);
+            return -1;
+        }
+        printf("Results written to %s\n", opt.outputPath.c_str());
+    } else {
+        fputs(json.c_str(), stdout);
+    }
+
+    cleanup(&s);
+    return daemonAlive ? 0 : 1;
+}
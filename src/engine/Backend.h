@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+
+#include "Monitor.h"
+
+typedef int DeviceId; // a master pointer, as numbered by the window system
+
+/*
+What the engine needs from the window system. The X11 daemon implements it with Xlib calls, the
+fake backend with a simulated pointer, so the engine itself never talks to a server. Every call
+is about one of the master pointers.
+*/
+class Backend {
+  public:
+    virtual ~Backend() {}
+
+    // Where the pointer is right now. May be a synchronous round-trip
+    virtual void queryPointer(DeviceId device, int *x, int *y) = 0;
+
+    // Moves the pointer
+    virtual void warpPointer(DeviceId device, int x, int y) = 0;
+
+    // Keeps the pointer inside the monitor, away from the resistance margins, until release().
+    // May do nothing for pointers that can't be confined; the engine warps them back instead
+    virtual void confine(DeviceId device, const Monitor &mon) = 0;
+
+    // Stops holding the pointer back, letting it through the edge it's held at
+    virtual void release(DeviceId device) = 0;
+
+    // Asks for Engine::deadlineExpired() to be called for the pointer after the delay, replacing
+    // any earlier request for it
+    virtual void armDeadline(DeviceId device, std::chrono::duration<float> delay) = 0;
+    virtual void disarmDeadline(DeviceId device) = 0;
+};
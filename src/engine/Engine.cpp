@@ -0,0 +1,681 @@
+#include "Engine.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+void Engine::configure(const EngineConfig &newCfg) {
+    cfg = newCfg;
+    if (!cfg.enabled)
+        unconfineAll();
+    for (Pointer &p : pointers) {
+        // The margins or the gating itself may have changed
+        ungate(p);
+        p.ptrMemory.configure(cfg.ptrInputsToRemember, cfg.ptrRememberFor, cfg.ptrCurrentSpeedFor);
+    }
+
+    // The corners and the profiles may have changed
+    if (!monitorList.empty()) {
+        buildLayout();
+        for (Pointer &p : pointers)
+            p.lastPassCfg = nullptr;
+    }
+}
+
+void Engine::forgetMovement() {
+    for (Pointer &p : pointers) {
+        ungate(p);
+        p.ptrMemory.clear();
+        p.trajectory.reset();
+        p.onEdge = false;
+        p.brokeFromMonitor = NoMonitor;
+        p.trackedPosValid = false;
+        p.lastPtrSyncTime = p.lastEventTime = EventTime();
+    }
+}
+
+/*
+The state of the pointer, created when it's first seen. Device ids are small numbers, so they
+index the table directly.
+*/
+Engine::Pointer &Engine::getPointer(DeviceId device) {
+    if (device >= (int)pointerIndices.size())
+        pointerIndices.resize(device + 1, -1);
+    int &index = pointerIndices[device];
+    if (index == -1) {
+        index = (int)pointers.size();
+        pointers.emplace_back();
+        pointers.back().device = device;
+        pointers.back().ptrMemory.configure(cfg.ptrInputsToRemember, cfg.ptrRememberFor,
+                                            cfg.ptrCurrentSpeedFor);
+    }
+    return pointers[index];
+}
+
+const Engine::Pointer *Engine::findPointer(DeviceId device) const {
+    if (device < 0 || device >= (int)pointerIndices.size() || pointerIndices[device] == -1)
+        return nullptr;
+    return &pointers[pointerIndices[device]];
+}
+
+const Monitor *Engine::getMonitor(MonitorId id) const {
+    if (id < 0 || id >= (int)monitorIndices.size() || monitorIndices[id] == -1)
+        return nullptr;
+    return &monitorList[monitorIndices[id]];
+}
+
+MonitorId Engine::getMonitorAt(int x, int y) const {
+    int index = monitorLayout.monitorAt(x, y);
+    return (index == -1) ? NoMonitor : monitorList[index].id;
+}
+
+void Engine::setMonitors(const std::vector<Monitor> &monitors) {
+    // The confining area might have moved
+    unconfineAll();
+
+    monitorList = monitors;
+
+    MonitorId maxId = NoMonitor;
+    for (const Monitor &mon : monitorList)
+        maxId = std::max(maxId, mon.id);
+    monitorIndices.assign(maxId + 1, -1);
+    for (int i = 0; i < (int)monitorList.size(); i++)
+        monitorIndices[monitorList[i].id] = i;
+
+    buildLayout();
+
+    for (Pointer &p : pointers) {
+        p.lastPassCfg = nullptr;
+        ungate(p);
+
+        // The movement history survives layout changes
+        syncPointer(p, p.lastEventTime);
+
+        // Find the monitor on which we are rn, if ours is gone or moved away
+        const Monitor *mon = getMonitor(p.current);
+        int x = (int)p.trackedX, y = (int)p.trackedY;
+        if (!mon || !mon->contains(x, y)) {
+            p.current = getMonitorAt(x, y);
+            p.onEdge = false;
+        }
+    }
+}
+
+/*
+Builds the monitor layout, and resolves the profiles for every edge segment in it up front, so the
+decision on each event finds its settings with one lookup however many profiles there are.
+*/
+void Engine::buildLayout() {
+    // Less specific profiles first, so the more specific ones override them
+    std::vector<const PassProfile *> profiles;
+    for (const PassProfile &profile : cfg.profiles)
+        profiles.push_back(&profile);
+    std::stable_sort(profiles.begin(), profiles.end(),
+                     [](const PassProfile *a, const PassProfile *b) {
+                         return a->specificity() < b->specificity();
+                     });
+
+    std::vector<MonitorRect> rects;
+    for (const Monitor &mon : monitorList) {
+        MonitorRect rect{mon.x, mon.y, mon.w, mon.h, cfg.cornerSizeFactor};
+        for (const PassProfile *profile : profiles)
+            if (profile->hasCornerSizeFactor &&
+                (profile->output.empty() || profile->output == mon.name))
+                rect.cornerSizeFactor = profile->cornerSizeFactor;
+        rects.push_back(rect);
+    }
+    monitorLayout.build(rects);
+
+    segmentPass.assign(monitorLayout.segmentCount(), SegmentPass{cfg.edgePass, cfg.cornerPass});
+    for (int i = 0; i < monitorLayout.size(); i++) {
+        const std::string &name = monitorList[i].name;
+        for (int side = 0; side < EdgeSideCount; side++) {
+            for (const EdgeSegment &segment : monitorLayout.edgesOf(i).segments[side]) {
+                SegmentPass &pass = segmentPass[segment.index];
+                for (const PassProfile *profile : profiles) {
+                    if ((!profile->output.empty() && profile->output != name) ||
+                        (profile->edge != -1 && profile->edge != side))
+                        continue;
+                    if (!profile->neighbour.empty() &&
+                        (!segment.shared() ||
+                         monitorList[segment.neighbour].name != profile->neighbour))
+                        continue;
+                    profile->edgePass.applyTo(&pass.edge);
+                    profile->cornerPass.applyTo(&pass.corner);
+                }
+                cfg.edgeOverride.applyTo(&pass.edge);
+                cfg.cornerOverride.applyTo(&pass.corner);
+            }
+        }
+    }
+}
+
+void Engine::syncPointer(Pointer &p, EventTime now) {
+    int x, y;
+    backend.queryPointer(p.device, &x, &y);
+    p.trackedX = x;
+    p.trackedY = y;
+    p.trackedPosValid = true;
+    p.trackedPosReckoned = false;
+    p.lastPtrSyncTime = now;
+}
+
+/*
+Gates the pointer if it's far enough from all shared edges of its monitor. The raw deltas move it
+by at most |dx| + |dy| towards any edge, so nothing needs checking until that much motion added up.
+Dead screen borders don't count, the pointer can't leave through them.
+*/
+void Engine::gate(Pointer &p) {
+    const Monitor *mon = getMonitor(p.current);
+    if (!cfg.ptrGateFarFromEdges || !mon || p.isConfined || p.onEdge)
+        return;
+
+    // The edge is reached within the margins, and the tracked position is rounded down
+    const int x = (int)std::floor(p.trackedX), y = (int)std::floor(p.trackedY);
+    const int slack = cfg.resistanceMargins + 2;
+    const int distances[EdgeSideCount] = {x - mon->x, mon->x + (int)mon->w - 1 - x, y - mon->y,
+                                          mon->y + (int)mon->h - 1 - y};
+
+    const MonitorEdges &edges = monitorLayout.edgesOf(mon - monitorList.data());
+    double nearest = INFINITY;
+    for (int side = 0; side < EdgeSideCount; side++) {
+        for (const EdgeSegment &segment : edges.segments[side]) {
+            if (segment.shared()) {
+                nearest = std::min(nearest, (double)(distances[side] - slack));
+                break;
+            }
+        }
+    }
+    if (nearest > 0.0) {
+        p.gated = true;
+        p.gateRemaining = nearest;
+    }
+}
+
+// Catches up with the movement history skipped while gated
+void Engine::ungate(Pointer &p) {
+    if (!p.gated)
+        return;
+    p.gated = false;
+    p.ptrMemory.settle();
+    p.ptrSpeed1 = p.ptrMemory.windowSpeed();
+    p.ptrSpeed2 = p.ptrMemory.recentSpeed();
+}
+
+bool Engine::idle() const {
+    for (const Pointer &p : pointers)
+        if (!p.gated)
+            return false;
+    return !pointers.empty();
+}
+
+/*
+Moves the tracked pointer position by the raw deltas, clamping it the same way the server would.
+Falls back to asking the backend when the position is unknown, too old, or when tracking from
+events is disabled.
+*/
+void Engine::trackPointer(Pointer &p, double dx, double dy, EventTime now, int *x, int *y) {
+    if (!cfg.ptrTrackFromEvents || !p.trackedPosValid ||
+        (now - p.lastPtrSyncTime) > cfg.ptrResyncInterval) {
+        syncPointer(p, now);
+    } else {
+        p.trackedX += dx;
+        p.trackedY += dy;
+        p.trackedPosReckoned = true;
+
+        // The server keeps the pointer on the screen, or inside the confining window
+        double minX = p.trackedX, minY = p.trackedY, maxX = p.trackedX, maxY = p.trackedY;
+        const Monitor *mon = getMonitor(p.current);
+        if (p.isConfined && mon) {
+            minX = mon->x + cfg.resistanceMargins;
+            minY = mon->y + cfg.resistanceMargins;
+            maxX = mon->x + (int)mon->w - cfg.resistanceMargins - 1;
+            maxY = mon->y + (int)mon->h - cfg.resistanceMargins - 1;
+        } else if (!monitorList.empty()) {
+            minX = minY = INFINITY;
+            maxX = maxY = -INFINITY;
+            for (const Monitor &m : monitorList) {
+                minX = std::min(minX, (double)m.x);
+                minY = std::min(minY, (double)m.y);
+                maxX = std::max(maxX, (double)(m.x + (int)m.w - 1));
+                maxY = std::max(maxY, (double)(m.y + (int)m.h - 1));
+            }
+        }
+        p.trackedX = std::max(minX, std::min(p.trackedX, maxX));
+        p.trackedY = std::max(minY, std::min(p.trackedY, maxY));
+    }
+
+    *x = (int)std::floor(p.trackedX);
+    *y = (int)std::floor(p.trackedY);
+}
+
+/*
+Asks the backend where the pointer is, if it was tracked from the raw deltas since the last sync.
+They don't see warps by other clients, e.g. games recentring the pointer, so a dead-reckoned
+position must be checked before the pointer is held or warped there. Returns false if the pointer
+was somewhere else; the tracked position is the real one either way.
+*/
+bool Engine::confirmPosition(Pointer &p) {
+    if (!p.trackedPosReckoned)
+        return true;
+    const double reckonedX = p.trackedX, reckonedY = p.trackedY;
+    syncPointer(p, p.lastEventTime);
+
+    // Sub-pixel motion rounds differently on the server
+    return std::abs(p.trackedX - reckonedX) + std::abs(p.trackedY - reckonedY) <= 2.0;
+}
+
+/*
+Holds the pointer in the monitor, unless it turns out not to be on it any more. Once held, the
+server keeps the pointer inside and the tracking clamps it the same way, so pushing on against the
+edge needs neither a warp nor a query.
+*/
+bool Engine::confine(Pointer &p, const Monitor &mon) {
+    // The barriers already hold the pointer
+    if (barrierMode)
+        return true;
+
+    StageTimer timer(engineStats, StageConfine);
+    const bool wasConfined = p.isConfined;
+    if (!wasConfined) {
+        if (!confirmPosition(p)) {
+            p.current = getMonitorAt((int)std::floor(p.trackedX), (int)std::floor(p.trackedY));
+            p.onEdge = false;
+            return false;
+        }
+        backend.confine(p.device, mon);
+        p.isConfined = true;
+        engineStats.count(StatConfines);
+    }
+
+    // warp the pointer back into the screen if it's outside the margins
+    int x = (int)std::floor(p.trackedX), y = (int)std::floor(p.trackedY);
+    const int trackedX = x, trackedY = y;
+    mon.snapPosition(&x, &y, cfg.resistanceMargins);
+    if (x != trackedX || y != trackedY) {
+        backend.warpPointer(p.device, x, y);
+        p.trackedX = x;
+        p.trackedY = y;
+        p.trackedPosReckoned = false;
+    }
+
+    // resync once the confinement took effect
+    if (!wasConfined)
+        p.trackedPosValid = false;
+    return true;
+}
+
+void Engine::unconfine(Pointer &p) {
+    if (p.isConfined) {
+        backend.release(p.device);
+        p.isConfined = false;
+        p.trackedPosValid = false;
+        engineStats.count(StatReleases);
+    }
+}
+
+void Engine::unconfine(DeviceId device) {
+    unconfine(getPointer(device));
+}
+
+void Engine::unconfineAll() {
+    for (Pointer &p : pointers)
+        unconfine(p);
+}
+
+/*
+Crosses from the current monitor to the one beyond the edge.
+*/
+void Engine::passEdge(Pointer &p, const Monitor &to, int x, int y, EventTime when) {
+    if (barrierMode) {
+        backend.release(p.device);
+        engineStats.count(StatReleases);
+    } else if (p.isConfined) {
+        // The backend held the pointer back, so move it to where it was going
+        unconfine(p);
+        x = std::max(to.x, std::min(x, to.x + (int)to.w - 1));
+        y = std::max(to.y, std::min(y, to.y + (int)to.h - 1));
+        backend.warpPointer(p.device, x, y);
+        p.trackedX = x;
+        p.trackedY = y;
+        p.trackedPosReckoned = false;
+    }
+
+    p.onEdge = false;
+    p.brokeFromTimepoint = when;
+    p.brokeFromMonitor = p.current;
+    p.current = to.id;
+    p.passes++;
+    engineStats.count(StatPasses);
+
+    backend.disarmDeadline(p.device);
+}
+
+void Engine::motion(DeviceId device, const MotionSample *samples, int count, bool absolute) {
+    if (!cfg.enabled || count == 0)
+        return;
+    Pointer &p = getPointer(device);
+
+    double sumDx = 0.0, sumDy = 0.0;
+    for (int i = 0; i < count; i++) {
+        sumDx += samples[i].dx;
+        sumDy += samples[i].dy;
+    }
+    p.lastEventTime = samples[count - 1].time;
+
+    // Far from the edges, only store the samples and add up how far the pointer may have got
+    if (p.gated) {
+        p.gateRemaining -= std::abs(sumDx) + std::abs(sumDy);
+        if (p.gateRemaining > 0.0 && !absolute) {
+            for (int i = 0; i < count; i++)
+                p.ptrMemory.pushLater(samples[i].time, samples[i].dx, samples[i].dy);
+            if (cfg.passModel == PassModelTrajectory)
+                for (int i = 0; i < count; i++)
+                    p.trajectory.push(samples[i].time, samples[i].dx, samples[i].dy);
+
+            // It can't reach a shared edge yet, so the server keeps it on its monitor
+            const Monitor *mon = getMonitor(p.current);
+            p.trackedX = std::max((double)mon->x,
+                                  std::min(p.trackedX + sumDx, (double)(mon->x + (int)mon->w - 1)));
+            p.trackedY = std::max((double)mon->y,
+                                  std::min(p.trackedY + sumDy, (double)(mon->y + (int)mon->h - 1)));
+            p.trackedPosReckoned = true;
+            engineStats.count(StatGatedBatches);
+            return;
+        }
+        ungate(p);
+    }
+
+    int x, y;
+    Stats::Clock::time_point stageStart = engineStats.start();
+    if (absolute) {
+        syncPointer(p, p.lastEventTime);
+        x = (int)std::floor(p.trackedX);
+        y = (int)std::floor(p.trackedY);
+    } else {
+        trackPointer(p, sumDx, sumDy, p.lastEventTime, &x, &y);
+    }
+    engineStats.record(StageTrack, stageStart);
+
+    // Remember the state
+    stageStart = engineStats.start();
+    for (int i = 0; i < count; i++)
+        p.ptrMemory.push(samples[i].time, samples[i].dx, samples[i].dy);
+    if (cfg.passModel == PassModelTrajectory)
+        for (int i = 0; i < count; i++)
+            p.trajectory.push(samples[i].time, samples[i].dx, samples[i].dy);
+
+    // Calc 2 average speeds to determine if we are accelerating or slowing
+    // down, and use the difference in further calcs
+    p.ptrSpeed1 = p.ptrMemory.windowSpeed();
+    p.ptrSpeed2 = p.ptrMemory.recentSpeed();
+    engineStats.record(StageSpeed, stageStart);
+
+    StageTimer timer(engineStats, StageDecision);
+    if (barrierMode)
+        pointerMovedBehindBarriers(p, x, y);
+    else
+        pointerPositionChanged(p, x, y);
+    if (!absolute)
+        gate(p);
+}
+
+void Engine::pointerAt(DeviceId device, int x, int y) {
+    if (!cfg.enabled)
+        return;
+    Pointer &p = getPointer(device);
+    ungate(p);
+
+    p.trackedX = x;
+    p.trackedY = y;
+    p.trackedPosValid = true;
+    p.trackedPosReckoned = false;
+    p.lastPtrSyncTime = p.lastEventTime;
+    pointerPositionChanged(p, x, y);
+}
+
+void Engine::barrierHit(DeviceId device, EventTime time, double x, double y, double dx,
+                        double dy) {
+    if (!cfg.enabled)
+        return;
+    Pointer &p = getPointer(device);
+    ungate(p);
+
+    // Raw motion may be paused, so the hit can be the only news of the push. The edge timers and
+    // speeds must go by it, not by whatever motion came last
+    if (p.ptrMemory.empty() || time > p.ptrMemory.back().time) {
+        p.ptrMemory.push(time, dx, dy);
+        if (cfg.passModel == PassModelTrajectory)
+            p.trajectory.push(time, dx, dy);
+        p.ptrSpeed1 = p.ptrMemory.windowSpeed();
+        p.ptrSpeed2 = p.ptrMemory.recentSpeed();
+    }
+    if (time > p.lastEventTime)
+        p.lastEventTime = time;
+
+    // The pointer may have moved anywhere on its monitor while gated, or not have been seen yet
+    const Monitor *mon = getMonitor(p.current);
+    if (!mon || !mon->contains((int)std::floor(x), (int)std::floor(y)))
+        p.current = getMonitorAt((int)std::floor(x), (int)std::floor(y));
+
+    // The event tells us exactly where the pointer is held
+    p.trackedX = x;
+    p.trackedY = y;
+    p.trackedPosValid = true;
+    p.trackedPosReckoned = false;
+    p.lastPtrSyncTime = p.lastEventTime;
+
+    // Decide based on where the pointer tried to go
+    StageTimer timer(engineStats, StageDecision);
+    pointerPositionChanged(p, (int)std::floor(x + dx), (int)std::floor(y + dy));
+}
+
+/*
+The delay for passing with the speeds model: the base delay, longer if the pointer is slowing down
+and shorter if it's speeding up.
+*/
+EngineConfig::Seconds Engine::speedDelay(const EngineConfig &cfg, const PassConfig &passCfg,
+                                         float speed1, float speed2, const PtrSample &sample,
+                                         bool onVerEdge) {
+    // Calc resistance factor for making it harder to pass
+    float resistanceFactor;
+    if (speed1 > 0 && speed2 > 0) {
+        // If we are slowing down, resistance must be higher (prolly
+        // trying to hit a button)
+        resistanceFactor = speed1 / speed2;
+
+        if (speed1 > speed2)
+            resistanceFactor = std::pow(resistanceFactor, cfg.resistanceSlowdownExponent);
+        else
+            resistanceFactor = std::pow(resistanceFactor, cfg.resistanceSpeedupExponent);
+
+        resistanceFactor *= std::pow(std::abs(speed1 - speed2) / std::max(speed1, speed2),
+                                     cfg.resistanceConstSpeedExponent);
+
+        if (onVerEdge && sample.dx != 0.0)
+            resistanceFactor *=
+                std::pow(sample.dist / std::abs(sample.dx), cfg.resistanceDirectionExponent);
+        else if (!onVerEdge && sample.dy != 0.0)
+            resistanceFactor *=
+                std::pow(sample.dist / std::abs(sample.dy), cfg.resistanceDirectionExponent);
+    } else {
+        resistanceFactor = 1;
+    }
+    resistanceFactor = (resistanceFactor - cfg.passthroughSmoothingFactor) /
+                       (1.0 - cfg.passthroughSmoothingFactor);
+
+    // adjust the base delay by the factor
+    return std::max(std::min(passCfg.baseDelay * resistanceFactor, passCfg.maxDelay),
+                    passCfg.minDelay);
+}
+
+/*
+The delay for passing with the trajectory model. A pointer headed TrajectoryAimPastPixels or more
+past the edge within TrajectoryHorizonSeconds gets the minimum delay, one that would come to rest
+right at the edge the maximum, and in between in proportion. Without motion out through the edge,
+e.g. sliding along it, the base delay applies.
+*/
+EngineConfig::Seconds Engine::trajectoryDelay(const EngineConfig &cfg, const PassConfig &passCfg,
+                                              const TrajectoryFilter &trajectory, EdgeSide side) {
+    static const float normals[EdgeSideCount][2] = {
+        {-1.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, -1.0f}, {0.0f, 1.0f}};
+    const float nx = normals[side][0], ny = normals[side][1];
+    if (trajectory.velocityX() * nx + trajectory.velocityY() * ny <= 0.0f)
+        return passCfg.baseDelay;
+
+    const float travel = trajectory.travel(nx, ny, cfg.trajectoryHorizon.count());
+    const float aimedPast = std::min(travel / cfg.trajectoryAimPast, 1.0f);
+    return passCfg.maxDelay - (passCfg.maxDelay - passCfg.minDelay) * aimedPast;
+}
+
+void Engine::pointerPositionChanged(Pointer &p, int x, int y) {
+
+    // Do nothing if we are outside any monitor
+    const Monitor *mon = getMonitor(p.current);
+    if (mon) {
+        const PtrSample sample = p.ptrMemory.back();
+        const int margins = cfg.resistanceMargins;
+
+        // If the pointer tries to exit the monitor. While confined, the backend keeps it inside,
+        // so check where the last movement would have taken it
+        int tryX = x, tryY = y;
+        if (p.isConfined) {
+            tryX = x + sample.dx;
+            tryY = y + sample.dy;
+        }
+
+        if (!mon->contains(tryX, tryY, margins)) {
+            const int monIndex = mon - monitorList.data();
+            const PassConfig *passCfg;
+            bool pass;
+
+            // Find the edge we are pushing against, and what lies beyond it
+            EdgeSide side;
+            if (tryX < mon->x + margins)
+                side = EdgeLeft;
+            else if (tryX >= (int)(mon->x + mon->w) - margins)
+                side = EdgeRight;
+            else if (tryY < mon->y + margins)
+                side = EdgeTop;
+            else
+                side = EdgeBottom;
+            bool onVerEdge = (side == EdgeLeft || side == EdgeRight);
+
+            const EdgeSegment &segment =
+                monitorLayout.segmentAt(monIndex, side, onVerEdge ? y : x);
+
+            // Nothing to resist on the border of the screen, the pointer can't leave anyway
+            if (!segment.shared())
+                return;
+
+            // The first decision of a touch goes by the real position. If the pointer was warped
+            // away by another client, decide again where it is now
+            if (!p.onEdge && !p.isConfined && !confirmPosition(p)) {
+                const int realX = (int)std::floor(p.trackedX), realY = (int)std::floor(p.trackedY);
+                if (mon->contains(realX, realY))
+                    pointerPositionChanged(p, realX, realY);
+                else
+                    p.current = getMonitorAt(realX, realY);
+                return;
+            }
+            const Monitor &newMonitor = monitorList[segment.neighbour];
+
+            const SegmentPass &segPass = segmentPass[segment.index];
+            if (monitorLayout.inCorner(monIndex, x, y))
+                passCfg = &segPass.corner;
+            else
+                passCfg = &segPass.edge;
+
+            duration<float> adjustedDelay(0.0f);
+
+            // Should we ignore the resistance altogether?
+            if (passCfg->always ||
+                (newMonitor.id == p.brokeFromMonitor &&
+                 (sample.time - p.brokeFromTimepoint) < passCfg->returnBefore)) {
+                pass = true;
+            } else {
+                // keep track of the time if we collided with the edge right now
+                if (!p.onEdge || passCfg != p.lastPassCfg) {
+                    p.onEdge = true;
+                    p.touchedEdgeTime = sample.time;
+                }
+
+                if (cfg.passModel == PassModelTrajectory)
+                    adjustedDelay = trajectoryDelay(cfg, *passCfg, p.trajectory, side);
+                else
+                    adjustedDelay =
+                        speedDelay(cfg, *passCfg, p.ptrSpeed1, p.ptrSpeed2, sample, onVerEdge);
+
+                // check how long have we been pushing through the edge and
+                // passthrough if it's longer than the expected delay
+                if ((sample.time - p.touchedEdgeTime) > adjustedDelay) {
+                    pass = true;
+                } else {
+                    pass = false;
+                }
+            }
+            p.lastPassCfg = passCfg;
+
+            if (pass) {
+                passEdge(p, newMonitor, tryX, tryY, sample.time);
+            } else {
+                /*
+                Manually setting the position causes the pointer to 'flicker'
+                because of the delay between the warp and actual pointer update
+                on screen. We let the backend confine the pointer in the monitor.
+                */
+                if (!confine(p, *mon))
+                    return;
+
+                /*
+                Let it through when the delay expires, even if no more events come. Every push
+                re-arms the deadline, so if it expires while not due, the pointer stopped pushing
+                for longer than StillPushingForSeconds and probably stopped to click something.
+                */
+                duration<float> remaining = adjustedDelay - (sample.time - p.touchedEdgeTime);
+                bool due = remaining <= cfg.stillPushingFor;
+                p.pendingPass = Pointer::PendingPass{
+                    newMonitor.id, tryX, tryY,
+                    p.touchedEdgeTime + duration_cast<EventClock::duration>(adjustedDelay), due};
+                backend.armDeadline(p.device, due ? remaining : cfg.stillPushingFor);
+            }
+        } else {
+            if (mon->contains(x + sample.dx, y + sample.dy, margins)) {
+                unconfine(p);
+            }
+            if (mon->contains(x, y, margins + 1)) {
+                p.onEdge = false;
+            }
+        }
+    } else {
+        p.current = getMonitorAt(x, y);
+    }
+}
+
+/*
+With barriers, the edge decision is made on barrier hits, so motion only needs to keep track of
+the monitor we are on.
+*/
+void Engine::pointerMovedBehindBarriers(Pointer &p, int x, int y) {
+    const Monitor *mon = getMonitor(p.current);
+    if (!mon || !mon->contains(x, y)) {
+        p.current = getMonitorAt(x, y);
+    } else if (mon->contains(x, y, cfg.resistanceMargins + 1)) {
+        p.onEdge = false;
+    }
+}
+
+/*
+The delay for passing through the edge expired. Pass if the pointer was still pushing against it,
+otherwise it probably stopped there to click something.
+*/
+void Engine::deadlineExpired(DeviceId device) {
+    Pointer &p = getPointer(device);
+    const Monitor *to = getMonitor(p.pendingPass.to);
+    if (p.onEdge && to && p.pendingPass.due) {
+        engineStats.count(StatDeadlinePasses);
+        passEdge(p, *to, p.pendingPass.x, p.pendingPass.y, p.pendingPass.deadline);
+    }
+}
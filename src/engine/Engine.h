@@ -0,0 +1,168 @@
+#pragma once
+
+#include <math.h>
+
+#include <vector>
+
+#include "Backend.h"
+#include "EngineConfig.h"
+#include "EventTime.h"
+#include "Monitor.h"
+#include "MonitorLayout.h"
+#include "PtrHistory.h"
+#include "Stats.h"
+#include "Trajectory.h"
+
+struct MotionSample {
+    EventTime time;
+    double dx, dy;
+};
+
+/*
+Decides when the pointers may cross from one monitor to another. All of its state lives in the
+object and all effects go through the backend, so any number of engines can run side by side.
+Each master pointer has its own movement history, edge timers and confinement, so several
+pointers never disturb each other.
+*/
+class Engine {
+  public:
+    explicit Engine(Backend &backend) : backend(backend) {}
+
+    void configure(const EngineConfig &cfg);
+    const EngineConfig &config() const { return cfg; }
+
+    // Replaces the monitor list. Monitors keep their state as long as their id stays the same
+    void setMonitors(const std::vector<Monitor> &monitors);
+
+    // With barriers, the server holds the pointer and the edges are decided on barrier hits
+    void decideOnBarrierHits(bool enable) { barrierMode = enable; }
+
+    // Raw motion of a pointer, oldest first. Every sample goes into the movement history, but the
+    // pointer position is resolved and the edge decision evaluated only once. The deltas of
+    // absolute devices, like tablets, are only estimated, so their position is asked instead
+    void motion(DeviceId device, const MotionSample *samples, int count, bool absolute = false);
+
+    // The server reported where the pointer is, e.g. in an event of the grab
+    void pointerAt(DeviceId device, int x, int y);
+
+    // The pointer at x, y pushed against a barrier by dx, dy at the given time. The push counts as
+    // motion, unless the raw motion of that time was already handed over
+    void barrierHit(DeviceId device, EventTime time, double x, double y, double dx, double dy);
+
+    // The delay requested with Backend::armDeadline() for the pointer expired
+    void deadlineExpired(DeviceId device);
+
+    // Lets the pointer go, e.g. so a click can be replayed
+    void unconfine(DeviceId device);
+    void unconfineAll();
+
+    // Forgets the movement of all pointers, e.g. when the timebase changes
+    void forgetMovement();
+
+    // True while every pointer is gated, too far from the shared edges for its motion to matter.
+    // Only a barrier hit or a new pointer needs attention then
+    bool idle() const;
+
+    const std::vector<Monitor> &monitors() const { return monitorList; }
+    const MonitorLayout &layout() const { return monitorLayout; }
+    const Monitor *getMonitor(MonitorId id) const;
+    MonitorId currentMonitor(DeviceId device) const {
+        const Pointer *p = findPointer(device);
+        return p ? p->current : NoMonitor;
+    }
+    void pointerPosition(DeviceId device, int *x, int *y) const {
+        const Pointer *p = findPointer(device);
+        *x = p ? (int)std::floor(p->trackedX) : 0;
+        *y = p ? (int)std::floor(p->trackedY) : 0;
+    }
+    bool confined(DeviceId device) const {
+        const Pointer *p = findPointer(device);
+        return p && p->isConfined;
+    }
+    // How many times the pointer was let through an edge, counted even without the statistics
+    unsigned long passCount(DeviceId device) const {
+        const Pointer *p = findPointer(device);
+        return p ? p->passes : 0;
+    }
+
+    // Counters and stage latencies of all pointers, disabled until enabled is set
+    Stats &stats() { return engineStats; }
+
+    // The delay for passing an edge with each pass model, from the pointer's movement so far
+    static EngineConfig::Seconds speedDelay(const EngineConfig &cfg, const PassConfig &passCfg,
+                                            float speed1, float speed2, const PtrSample &sample,
+                                            bool onVerEdge);
+    static EngineConfig::Seconds trajectoryDelay(const EngineConfig &cfg, const PassConfig &passCfg,
+                                                 const TrajectoryFilter &trajectory, EdgeSide side);
+
+  private:
+    // The state of one master pointer
+    struct Pointer {
+        DeviceId device;
+        MonitorId current = NoMonitor; // the monitor in which the pointer is
+        bool isConfined = false;       // the backend holds the pointer in the current monitor
+
+        // Pointer tracking
+        double trackedX = 0.0, trackedY = 0.0; // position, dead-reckoned from the raw deltas
+        bool trackedPosValid = false;          // false when the next motion must resync
+        bool trackedPosReckoned = false;       // moved by raw deltas since the last sync
+        EventTime lastPtrSyncTime;             // when we last queried the backend
+        EventTime lastEventTime;               // the newest motion seen
+
+        // Gating: while far from the shared edges, motion is only counted until it could reach one
+        bool gated = false;
+        double gateRemaining = 0.0; // distance left before the position must be checked again
+
+        // Resistance calculation
+        PtrHistory ptrMemory;
+        float ptrSpeed1 = 0.0f, ptrSpeed2 = 0.0f;
+        TrajectoryFilter trajectory; // only fed with the trajectory pass model
+        bool onEdge = false; // are we on edge rn
+        const PassConfig *lastPassCfg = nullptr;
+        EventTime touchedEdgeTime;    // the time point when we touched the edge, to detect delay
+        EventTime brokeFromTimepoint; // the time point when we last broke from a monitor
+        MonitorId brokeFromMonitor = NoMonitor; // the monitor we passed FROM last time. Useful
+                                                // for returning to previous monitor when we
+                                                // miss a button or smthng.
+        struct PendingPass {
+            MonitorId to;
+            int x, y;           // where the pointer was trying to go
+            EventTime deadline; // when it's let through
+            bool due; // false if the deadline only checks that the pointer stopped pushing
+        } pendingPass{NoMonitor, 0, 0, EventTime(), false};
+        unsigned long passes = 0; // edges let through
+    };
+
+    Pointer &getPointer(DeviceId device);
+    const Pointer *findPointer(DeviceId device) const;
+    MonitorId getMonitorAt(int x, int y) const;
+    void buildLayout();
+    void trackPointer(Pointer &p, double dx, double dy, EventTime now, int *x, int *y);
+    void syncPointer(Pointer &p, EventTime now);
+    void gate(Pointer &p);
+    void ungate(Pointer &p);
+    bool confirmPosition(Pointer &p);
+    bool confine(Pointer &p, const Monitor &mon);
+    void unconfine(Pointer &p);
+    void passEdge(Pointer &p, const Monitor &to, int x, int y, EventTime when);
+    void pointerPositionChanged(Pointer &p, int x, int y);
+    void pointerMovedBehindBarriers(Pointer &p, int x, int y);
+
+    Backend &backend;
+    EngineConfig cfg;
+    bool barrierMode = false;
+    Stats engineStats;
+
+    // Monitors
+    std::vector<Monitor> monitorList;
+    std::vector<int> monitorIndices; // index into monitorList for each id, -1 for removed ones
+    MonitorLayout monitorLayout;     // lookup tables for the monitors
+    struct SegmentPass {
+        PassConfig edge, corner;
+    };
+    std::vector<SegmentPass> segmentPass; // by EdgeSegment::index, with the profiles applied
+
+    // Pointers, in the order they were first seen
+    std::vector<Pointer> pointers;
+    std::vector<int> pointerIndices; // index into pointers for each device id, -1 for unseen ones
+};
@@ -0,0 +1,437 @@
+#include "EngineConfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+using namespace std::chrono;
+
+namespace {
+
+duration<float> getSeconds(MiIni<std::string> &config, const std::string &section,
+                           const std::string &key, duration<float> def) {
+    return (duration<float>)config.get(section, key, (double)def.count());
+}
+
+void readPassConfig(MiIni<std::string> &config, const std::string &section, const PassConfig &def,
+                    PassConfig *pass) {
+    pass->always = config.get(section, "AllowAlways", def.always);
+    pass->baseDelay = getSeconds(config, section, "BaseDelayOfSeconds", def.baseDelay);
+    pass->maxDelay = getSeconds(config, section, "MaxDelayOfSeconds", def.maxDelay);
+    pass->minDelay = getSeconds(config, section, "MinDelayOfSeconds", def.minDelay);
+    pass->returnBefore = getSeconds(config, section, "FreelyReturnBeforeSeconds", def.returnBefore);
+}
+
+/*
+Profiles and app rules
+*/
+const char *const edgeNames[] = {"left", "right", "top", "bottom"}; // in EdgeSide order
+
+std::string trim(const std::string &text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+        return std::string();
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+// Reads a comma-separated list of names
+std::vector<std::string> getList(MiIni<std::string> &config, const std::string &section,
+                                 const std::string &key, const std::vector<std::string> &def) {
+    std::string defList;
+    for (const std::string &name : def)
+        defList += (defList.empty() ? "" : ", ") + name;
+    const std::string list = config.get(section, key, defList);
+
+    std::vector<std::string> names;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string name = trim(list.substr(begin, end - begin));
+        if (!name.empty())
+            names.push_back(name);
+        begin = end + 1;
+    }
+    return names;
+}
+
+/*
+Reads an optional number. It's left empty to keep the global setting, so returns whether it's
+set. A value that isn't a number is noted in invalidKey.
+*/
+bool getOverride(MiIni<std::string> &config, const std::string &section, const std::string &key,
+                 bool hasDef, float def, float *value, std::string *invalidKey) {
+    std::string text;
+    if (hasDef) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", def);
+        text = buf;
+    }
+    text = trim(config.get(section, key, text));
+    if (text.empty())
+        return false;
+
+    char *end;
+    *value = strtof(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0') {
+        if (invalidKey->empty())
+            *invalidKey = key;
+        return false;
+    }
+    return true;
+}
+
+bool getOverride(MiIni<std::string> &config, const std::string &section, const std::string &key,
+                 bool hasDef, bool def, bool *value, std::string *invalidKey) {
+    std::string text = hasDef ? (def ? "true" : "false") : "";
+    text = trim(config.get(section, key, text));
+    if (text.empty())
+        return false;
+
+    if (text == "true" || text == "1") {
+        *value = true;
+    } else if (text == "false" || text == "0") {
+        *value = false;
+    } else {
+        if (invalidKey->empty())
+            *invalidKey = key;
+        return false;
+    }
+    return true;
+}
+
+void readPassOverride(MiIni<std::string> &config, const std::string &section,
+                      const std::string &prefix, const PassOverride &def, PassOverride *pass,
+                      std::string *invalidKey) {
+    struct Key {
+        const char *name;
+        PassOverride::Field field;
+        std::chrono::duration<float> PassConfig::*delay;
+    };
+    static const Key delays[] = {
+        {"BaseDelayOfSeconds", PassOverride::BaseDelay, &PassConfig::baseDelay},
+        {"MaxDelayOfSeconds", PassOverride::MaxDelay, &PassConfig::maxDelay},
+        {"MinDelayOfSeconds", PassOverride::MinDelay, &PassConfig::minDelay},
+        {"FreelyReturnBeforeSeconds", PassOverride::ReturnBefore, &PassConfig::returnBefore},
+    };
+
+    pass->fields = 0;
+    if (getOverride(config, section, prefix + "AllowAlways", def.fields & PassOverride::AllowAlways,
+                    def.values.always, &pass->values.always, invalidKey))
+        pass->fields |= PassOverride::AllowAlways;
+    for (const Key &key : delays) {
+        float seconds;
+        if (getOverride(config, section, prefix + key.name, def.fields & key.field,
+                        (def.values.*key.delay).count(), &seconds, invalidKey)) {
+            pass->values.*key.delay = duration<float>(seconds);
+            pass->fields |= key.field;
+        }
+    }
+}
+
+// The entry with the given name, or a default one
+template <typename T> const T &findByName(const std::vector<T> &entries, const std::string &name) {
+    static const T none;
+    for (const T &entry : entries)
+        if (entry.name == name)
+            return entry;
+    return none;
+}
+
+// Reads the profiles listed in [Screen] Profiles, each from its own section
+void readProfiles(MiIni<std::string> &config, std::vector<PassProfile> *profiles,
+                  const std::vector<PassProfile> &defs) {
+    std::vector<std::string> defNames;
+    for (const PassProfile &def : defs)
+        defNames.push_back(def.name);
+
+    profiles->clear();
+    for (const std::string &name : getList(config, "Screen", "Profiles", defNames)) {
+        // The defaults are those of the profile with the same name, if any
+        const PassProfile &def = findByName(defs, name);
+        const std::string section = "Profile " + name;
+        PassProfile profile;
+        profile.name = name;
+
+        profile.output = trim(config.get(section, "Output", def.output));
+        const std::string edge = trim(config.get(
+            section, "Edge", std::string(def.edge == -1 ? "all" : edgeNames[def.edge])));
+        if (edge != "all") {
+            for (int side = 0; side < 4; side++)
+                if (edge == edgeNames[side])
+                    profile.edge = side;
+            if (profile.edge == -1)
+                profile.invalidKey = "Edge";
+        }
+        profile.neighbour = trim(config.get(section, "Neighbour", def.neighbour));
+        profile.hasCornerSizeFactor =
+            getOverride(config, section, "CornerSizeFactor", def.hasCornerSizeFactor,
+                        def.cornerSizeFactor, &profile.cornerSizeFactor, &profile.invalidKey);
+        readPassOverride(config, section, "Edge", def.edgePass, &profile.edgePass,
+                         &profile.invalidKey);
+        readPassOverride(config, section, "Corner", def.cornerPass, &profile.cornerPass,
+                         &profile.invalidKey);
+
+        profiles->push_back(profile);
+    }
+}
+
+// Reads the rules listed in [General] AppRules, each from its own section
+void readAppRules(MiIni<std::string> &config, std::vector<AppRule> *rules,
+                  const std::vector<AppRule> &defs) {
+    std::vector<std::string> defNames;
+    for (const AppRule &def : defs)
+        defNames.push_back(def.name);
+
+    rules->clear();
+    for (const std::string &name : getList(config, "General", "AppRules", defNames)) {
+        const AppRule &def = findByName(defs, name);
+        const std::string section = "App " + name;
+        AppRule rule;
+        rule.name = name;
+
+        rule.windowClass = trim(config.get(section, "Class", def.windowClass));
+        rule.title = trim(config.get(section, "Title", def.title));
+        rule.hasEnabled = getOverride(config, section, "Enabled", def.hasEnabled, def.enabled,
+                                      &rule.enabled, &rule.invalidKey);
+        readPassOverride(config, section, "Edge", def.edgePass, &rule.edgePass, &rule.invalidKey);
+        readPassOverride(config, section, "Corner", def.cornerPass, &rule.cornerPass,
+                         &rule.invalidKey);
+
+        rules->push_back(rule);
+    }
+}
+
+bool validatePassConfig(const PassConfig &pass, const std::string &section, std::string *error) {
+    for (float delay : {pass.baseDelay.count(), pass.minDelay.count(), pass.maxDelay.count(),
+                        pass.returnBefore.count()}) {
+        if (!std::isfinite(delay) || delay < 0.0f) {
+            *error = "[" + section + "] delays must be zero or more seconds";
+            return false;
+        }
+    }
+    if (pass.minDelay > pass.maxDelay) {
+        *error = "[" + section + "] MinDelayOfSeconds is larger than MaxDelayOfSeconds";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void PassOverride::applyTo(PassConfig *pass) const {
+    if (fields & AllowAlways)
+        pass->always = values.always;
+    if (fields & MaxDelay)
+        pass->maxDelay = values.maxDelay;
+    if (fields & MinDelay)
+        pass->minDelay = values.minDelay;
+    if (fields & BaseDelay)
+        pass->baseDelay = values.baseDelay;
+    if (fields & ReturnBefore)
+        pass->returnBefore = values.returnBefore;
+}
+
+bool AppRule::matches(const std::string &instance, const std::string &className,
+                      const std::string &windowTitle) const {
+    return (windowClass.empty() || windowClass == instance || windowClass == className) &&
+           (title.empty() || windowTitle.find(title) != std::string::npos);
+}
+
+EngineConfig withAppRule(const EngineConfig &cfg, const AppRule &rule) {
+    EngineConfig ruled = cfg;
+    if (rule.hasEnabled)
+        ruled.enabled = rule.enabled;
+    ruled.edgeOverride = rule.edgePass;
+    ruled.cornerOverride = rule.cornerPass;
+    return ruled;
+}
+
+void readEngineConfig(MiIni<std::string> &config, EngineConfig *cfg, const EngineConfig &def) {
+    cfg->enabled = config.get("General", "Enabled", def.enabled);
+    readAppRules(config, &cfg->appRules, def.appRules);
+
+    cfg->cornerSizeFactor = config.get("Screen", "CornerSizeFactor", def.cornerSizeFactor);
+    cfg->resistanceMargins = config.get("Screen", "ResistanceMargins", def.resistanceMargins);
+    readProfiles(config, &cfg->profiles, def.profiles);
+
+    readPassConfig(config, "Edge Passthrough", def.edgePass, &cfg->edgePass);
+    readPassConfig(config, "Corner Passthrough", def.cornerPass, &cfg->cornerPass);
+
+    cfg->ptrInputsToRemember =
+        config.get("Movement Calculation", "NoInputsToRemember", def.ptrInputsToRemember);
+    cfg->ptrRememberFor =
+        getSeconds(config, "Movement Calculation", "RememberForSeconds", def.ptrRememberFor);
+    cfg->ptrCurrentSpeedFor = getSeconds(config, "Movement Calculation", "CurrentSpeedForSeconds",
+                                         def.ptrCurrentSpeedFor);
+    cfg->stillPushingFor = getSeconds(config, "Movement Calculation", "StillPushingForSeconds",
+                                      def.stillPushingFor);
+    cfg->resistanceSlowdownExponent = config.get("Movement Calculation",
+                                                 "ResistanceSlowdownExponent",
+                                                 def.resistanceSlowdownExponent);
+    cfg->resistanceSpeedupExponent = config.get("Movement Calculation",
+                                                "ResistanceSpeedupExponent",
+                                                def.resistanceSpeedupExponent);
+    cfg->resistanceConstSpeedExponent = config.get("Movement Calculation",
+                                                   "ResistanceConstantSpeedExponent",
+                                                   def.resistanceConstSpeedExponent);
+    cfg->resistanceDirectionExponent = config.get("Movement Calculation",
+                                                  "ResistanceByDirectionExponent",
+                                                  def.resistanceDirectionExponent);
+    cfg->passthroughSmoothingFactor = config.get("Movement Calculation",
+                                                 "PassthroughSmoothingFactor",
+                                                 def.passthroughSmoothingFactor);
+    const std::string defModel = (def.passModel == PassModelTrajectory) ? "trajectory" : "speeds";
+    cfg->passModel = (config.get("Movement Calculation", "PassModel", defModel) == "trajectory")
+                         ? PassModelTrajectory
+                         : PassModelSpeeds;
+    cfg->trajectoryAimPast =
+        config.get("Movement Calculation", "TrajectoryAimPastPixels", def.trajectoryAimPast);
+    cfg->trajectoryHorizon = getSeconds(config, "Movement Calculation", "TrajectoryHorizonSeconds",
+                                        def.trajectoryHorizon);
+
+    const std::string defMode = def.ptrTrackFromEvents ? "events" : "query";
+    cfg->ptrTrackFromEvents = (config.get("Pointer Tracking", "Mode", defMode) != "query");
+    cfg->ptrResyncInterval =
+        getSeconds(config, "Pointer Tracking", "ResyncIntervalSeconds", def.ptrResyncInterval);
+    cfg->ptrGateFarFromEdges =
+        config.get("Pointer Tracking", "GateFarFromEdges", def.ptrGateFarFromEdges);
+}
+
+bool validateEngineConfig(const EngineConfig &cfg, std::string *error) {
+    if (!(cfg.cornerSizeFactor >= 0.0f && cfg.cornerSizeFactor <= 0.5f)) {
+        *error = "[Screen] CornerSizeFactor must be between 0 and 0.5";
+        return false;
+    }
+    // The confining windows must still have some size on small monitors
+    if (cfg.resistanceMargins < 0 || cfg.resistanceMargins > 100) {
+        *error = "[Screen] ResistanceMargins must be between 0 and 100";
+        return false;
+    }
+
+    if (!validatePassConfig(cfg.edgePass, "Edge Passthrough", error) ||
+        !validatePassConfig(cfg.cornerPass, "Corner Passthrough", error))
+        return false;
+
+    for (const PassProfile &profile : cfg.profiles) {
+        const std::string section = "Profile " + profile.name;
+        if (!profile.invalidKey.empty()) {
+            *error = "[" + section + "] " + profile.invalidKey + " has an invalid value";
+            return false;
+        }
+        if (profile.hasCornerSizeFactor) {
+            if (profile.edge != -1 || !profile.neighbour.empty()) {
+                *error = "[" + section + "] CornerSizeFactor is for whole monitors, without "
+                                         "Edge or Neighbour";
+                return false;
+            }
+            if (!(profile.cornerSizeFactor >= 0.0f && profile.cornerSizeFactor <= 0.5f)) {
+                *error = "[" + section + "] CornerSizeFactor must be between 0 and 0.5";
+                return false;
+            }
+        }
+
+        // Checked on top of the global settings, as they'd apply with no other profile
+        PassConfig edgePass = cfg.edgePass, cornerPass = cfg.cornerPass;
+        profile.edgePass.applyTo(&edgePass);
+        profile.cornerPass.applyTo(&cornerPass);
+        if (!validatePassConfig(edgePass, section, error) ||
+            !validatePassConfig(cornerPass, section, error))
+            return false;
+    }
+
+    for (const AppRule &rule : cfg.appRules) {
+        const std::string section = "App " + rule.name;
+        if (!rule.invalidKey.empty()) {
+            *error = "[" + section + "] " + rule.invalidKey + " has an invalid value";
+            return false;
+        }
+        PassConfig edgePass = cfg.edgePass, cornerPass = cfg.cornerPass;
+        rule.edgePass.applyTo(&edgePass);
+        rule.cornerPass.applyTo(&cornerPass);
+        if (!validatePassConfig(edgePass, section, error) ||
+            !validatePassConfig(cornerPass, section, error))
+            return false;
+    }
+
+    if (cfg.ptrInputsToRemember < 2 || cfg.ptrInputsToRemember > (1 << 20)) {
+        *error = "[Movement Calculation] NoInputsToRemember must be between 2 and 1048576";
+        return false;
+    }
+    if (!(cfg.ptrRememberFor.count() > 0.0f) || !(cfg.ptrCurrentSpeedFor.count() > 0.0f) ||
+        cfg.ptrCurrentSpeedFor > cfg.ptrRememberFor) {
+        *error = "[Movement Calculation] CurrentSpeedForSeconds must be more than zero and at "
+                 "most RememberForSeconds";
+        return false;
+    }
+    if (!(cfg.stillPushingFor.count() >= 0.0f)) {
+        *error = "[Movement Calculation] StillPushingForSeconds must be zero or more";
+        return false;
+    }
+    for (float exponent : {cfg.resistanceSlowdownExponent, cfg.resistanceSpeedupExponent,
+                           cfg.resistanceConstSpeedExponent, cfg.resistanceDirectionExponent}) {
+        if (!std::isfinite(exponent) || exponent < 0.0f) {
+            *error = "[Movement Calculation] the exponents must be zero or more";
+            return false;
+        }
+    }
+    // The resistance factor is divided by 1 - PassthroughSmoothingFactor
+    if (!(cfg.passthroughSmoothingFactor >= 0.0f && cfg.passthroughSmoothingFactor < 1.0f)) {
+        *error = "[Movement Calculation] PassthroughSmoothingFactor must be at least 0 and less "
+                 "than 1";
+        return false;
+    }
+    if (!std::isfinite(cfg.trajectoryAimPast) || cfg.trajectoryAimPast <= 0.0f) {
+        *error = "[Movement Calculation] TrajectoryAimPastPixels must be more than zero";
+        return false;
+    }
+    if (!(cfg.trajectoryHorizon.count() > 0.0f)) {
+        *error = "[Movement Calculation] TrajectoryHorizonSeconds must be more than zero";
+        return false;
+    }
+
+    if (!(cfg.ptrResyncInterval.count() >= 0.0f)) {
+        *error = "[Pointer Tracking] ResyncIntervalSeconds must be zero or more";
+        return false;
+    }
+    return true;
+}
+
+void writeEngineConfig(const std::string &path, const EngineConfig &cfg,
+                       const std::string &basePath, const std::vector<ConfigKey> &keys) {
+    // The base without the keys to replace. Read whole first, it may be the file written to
+    std::string kept;
+    if (basePath != "") {
+        std::ifstream in(basePath);
+        std::string line, section;
+        while (std::getline(in, line)) {
+            const std::string text = trim(line);
+            const size_t eq = text.find('=');
+            if (!text.empty() && text[0] == '[' && text.back() == ']') {
+                section = trim(text.substr(1, text.size() - 2));
+            } else if (eq != std::string::npos) {
+                const std::string key = trim(text.substr(0, eq));
+                if (std::any_of(keys.begin(), keys.end(), [&](const ConfigKey &k) {
+                        return k.section == section && k.key == key;
+                    }))
+                    continue;
+            }
+            kept += line + "\n";
+        }
+    }
+
+    // Every key missing from the file is added with the given value when reading
+    remove(path.c_str());
+    if (kept != "")
+        std::ofstream(path) << kept;
+
+    MiIni<std::string> config;
+    config.open(path, false);
+    EngineConfig written;
+    readEngineConfig(config, &written, cfg);
+    config.sync();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <MiIni.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct PassConfig {
+    bool always;
+    std::chrono::duration<float> maxDelay, minDelay, baseDelay;
+    std::chrono::duration<float> returnBefore;
+};
+
+// Some of the fields of a PassConfig, replacing those of another one
+struct PassOverride {
+    enum Field { AllowAlways = 1, MaxDelay = 2, MinDelay = 4, BaseDelay = 8, ReturnBefore = 16 };
+    unsigned int fields = 0; // the ones that are set
+    PassConfig values{false, {}, {}, {}, {}};
+
+    void applyTo(PassConfig *pass) const;
+};
+
+/*
+Settings for the edges of one monitor, from a [Profile <name>] section. Where several profiles
+match an edge, the ones naming more of output, edge and neighbour win, then the later ones.
+*/
+struct PassProfile {
+    std::string name;
+    std::string output;    // output name as listed by xrandr, e.g. DP-1. Empty for any monitor
+    int edge = -1;         // EdgeSide, -1 for all edges
+    std::string neighbour; // output beyond the edge, empty for any
+    bool hasCornerSizeFactor = false;
+    float cornerSizeFactor = 0.0f; // only for whole monitors, without edge or neighbour
+    PassOverride edgePass, cornerPass;
+    std::string invalidKey; // a key whose value couldn't be read, if any
+
+    int specificity() const {
+        return !output.empty() + (edge != -1) + !neighbour.empty();
+    }
+};
+
+/*
+Settings for while a window is focused, from an [App <name>] section. The first rule matching the
+focused window applies, over the global settings and the profiles.
+*/
+struct AppRule {
+    std::string name;
+    std::string windowClass; // instance or class name in WM_CLASS, empty for any
+    std::string title;       // part of _NET_WM_NAME, empty for any
+    bool hasEnabled = false;
+    bool enabled = true;
+    PassOverride edgePass, cornerPass;
+    std::string invalidKey; // a key whose value couldn't be read, if any
+
+    bool matches(const std::string &instance, const std::string &className,
+                 const std::string &windowTitle) const;
+};
+
+// How the delay for passing an edge is worked out from the pointer's movement
+enum PassModel {
+    PassModelSpeeds,     // from the average speeds over a long and a short window
+    PassModelTrajectory, // from how far past the edge the pointer's trajectory leads
+};
+
+/*
+Settings of the edge resistance. The member initializers are the defaults written to a new config.
+*/
+struct EngineConfig {
+    typedef std::chrono::duration<float> Seconds;
+
+    bool enabled = true;
+    std::vector<AppRule> appRules; // listed in AppRules, in that order
+
+    // [Screen]
+    float cornerSizeFactor = 0.1f;
+    int resistanceMargins = 1;
+    std::vector<PassProfile> profiles; // listed in Profiles, in that order
+
+    // Set from the rule of the focused window, applied over the profiles. Not read from the file
+    PassOverride edgeOverride, cornerOverride;
+
+    // [Edge Passthrough] and [Corner Passthrough]
+    PassConfig edgePass{false, Seconds(0.6f), Seconds(0.0f), Seconds(0.4f), Seconds(1.0f)};
+    PassConfig cornerPass{false, Seconds(1.0f), Seconds(0.0f), Seconds(0.7f), Seconds(1.0f)};
+
+    // [Movement Calculation]
+    int ptrInputsToRemember = 2048;
+    Seconds ptrRememberFor{0.15f};
+    Seconds ptrCurrentSpeedFor{0.02f};
+    Seconds stillPushingFor{0.1f};
+    float resistanceSlowdownExponent = 4.0f;
+    float resistanceSpeedupExponent = 1.0f;
+    float resistanceConstSpeedExponent = 0.1f;
+    float resistanceDirectionExponent = 1.0f;
+    float passthroughSmoothingFactor = 0.05f;
+    PassModel passModel = PassModelSpeeds;
+    float trajectoryAimPast = 150.0f; // pixels past the edge that make a sure crossing
+    Seconds trajectoryHorizon{0.1f};  // how far ahead the trajectory is followed
+
+    // [Pointer Tracking]
+    bool ptrTrackFromEvents = true;
+    Seconds ptrResyncInterval{0.5f};
+    bool ptrGateFarFromEdges = false; // skip motion that can't reach a shared edge yet
+};
+
+// Reads the engine's settings, adding the missing ones with their defaults
+void readEngineConfig(MiIni<std::string> &config, EngineConfig *cfg,
+                      const EngineConfig &defaults = EngineConfig());
+
+// Checks that the settings make sense together. Describes the first problem if they don't
+bool validateEngineConfig(const EngineConfig &cfg, std::string *error);
+
+// The settings while the rule is in effect
+EngineConfig withAppRule(const EngineConfig &cfg, const AppRule &rule);
+
+struct ConfigKey {
+    std::string section, key;
+};
+
+// Writes the settings to a config file, replacing the file if it exists. With a base config, the
+// file is a copy of it, with the sections the engine doesn't read, and only the given keys take
+// the values of the settings
+void writeEngineConfig(const std::string &path, const EngineConfig &cfg,
+                       const std::string &basePath = "", const std::vector<ConfigKey> &keys = {});
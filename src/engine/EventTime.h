@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+
+/*
+Timebase of the pointer events. The time points are either X server timestamps, extended from
+32 bits so they survive the wraparound every ~49.7 days, or local clock samples for servers with
+unreliable timestamps. Only points from the same source may be compared.
+*/
+struct EventClock {
+    typedef std::chrono::microseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<EventClock> time_point;
+    static const bool is_steady = true;
+
+    static time_point fromLocalClock() {
+        return time_point(std::chrono::duration_cast<duration>(
+            std::chrono::steady_clock::now().time_since_epoch()));
+    }
+};
+typedef EventClock::time_point EventTime;
+
+/*
+Turns 32-bit millisecond X timestamps into monotonic EventTimes. The difference to the previous
+timestamp is taken as a signed 32-bit value, so a wraparound moves forward, and slightly
+out-of-order timestamps move back a bit instead of jumping by 49 days.
+*/
+class ServerTimeExtender {
+  public:
+    EventTime extend(unsigned long serverTime) {
+        const uint32_t t = (uint32_t)serverTime;
+        if (!started) {
+            started = true;
+            extended = t;
+        } else {
+            extended += (int32_t)(t - last);
+        }
+        last = t;
+        return EventTime(std::chrono::milliseconds(extended));
+    }
+
+    void reset() { started = false; }
+
+  private:
+    bool started = false;
+    uint32_t last = 0;
+    int64_t extended = 0;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+typedef int MonitorId; // stays the same for as long as the monitor exists
+const MonitorId NoMonitor = -1;
+
+struct Monitor {
+    MonitorId id;
+    int x, y;
+    unsigned int w, h;
+    std::string name; // of the output showing it, e.g. DP-1. Empty if unknown
+
+    bool contains(int xpos, int ypos, int margin = 0) const {
+        return (xpos >= x + margin && xpos < (x + (int)w - margin) && ypos >= y + margin &&
+                ypos < (y + (int)h - margin));
+    }
+
+    // Moves the position inside the monitor, margin pixels away from its edges
+    void snapPosition(int *xpos, int *ypos, int margin) const {
+        if (*xpos < x + margin)
+            *xpos = x + margin;
+        if (*ypos < y + margin)
+            *ypos = y + margin;
+        if (*xpos > x + (int)w - margin - 1)
+            *xpos = x + (int)w - margin - 1;
+        if (*ypos > y + (int)h - margin - 1)
+            *ypos = y + (int)h - margin - 1;
+    }
+};
@@ -0,0 +1,111 @@
+#include "MonitorLayout.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+void MonitorLayout::build(const std::vector<MonitorRect> &newRects) {
+    rects = newRects;
+    edges.clear();
+    numSegments = 0;
+    xBounds.clear();
+    yBounds.clear();
+    grid.clear();
+
+    if (rects.empty())
+        return;
+
+    // Grid lines on every monitor boundary
+    for (const MonitorRect &r : rects) {
+        xBounds.push_back(r.x);
+        xBounds.push_back(r.x + (int)r.w);
+        yBounds.push_back(r.y);
+        yBounds.push_back(r.y + (int)r.h);
+    }
+    std::sort(xBounds.begin(), xBounds.end());
+    xBounds.erase(std::unique(xBounds.begin(), xBounds.end()), xBounds.end());
+    std::sort(yBounds.begin(), yBounds.end());
+    yBounds.erase(std::unique(yBounds.begin(), yBounds.end()), yBounds.end());
+
+    // Fill the cells. If monitors overlap, the later one wins
+    const int cols = (int)xBounds.size() - 1;
+    const int rows = (int)yBounds.size() - 1;
+    grid.assign(cols * rows, -1);
+    for (int i = 0; i < (int)rects.size(); i++) {
+        const MonitorRect &r = rects[i];
+        int c1 = std::lower_bound(xBounds.begin(), xBounds.end(), r.x) - xBounds.begin();
+        int c2 = std::lower_bound(xBounds.begin(), xBounds.end(), r.x + (int)r.w) - xBounds.begin();
+        int r1 = std::lower_bound(yBounds.begin(), yBounds.end(), r.y) - yBounds.begin();
+        int r2 = std::lower_bound(yBounds.begin(), yBounds.end(), r.y + (int)r.h) - yBounds.begin();
+        for (int row = r1; row < r2; row++)
+            for (int col = c1; col < c2; col++)
+                grid[row * cols + col] = i;
+    }
+
+    // Edge tables, looking one pixel beyond each edge
+    edges.resize(rects.size());
+    for (int i = 0; i < (int)rects.size(); i++) {
+        const MonitorRect &r = rects[i];
+        MonitorEdges &e = edges[i];
+
+        addSegments(i, EdgeLeft, r.x - 1, r.y, r.y + (int)r.h);
+        addSegments(i, EdgeRight, r.x + (int)r.w, r.y, r.y + (int)r.h);
+        addSegments(i, EdgeTop, r.y - 1, r.x, r.x + (int)r.w);
+        addSegments(i, EdgeBottom, r.y + (int)r.h, r.x, r.x + (int)r.w);
+
+        e.cornerLeft = (int)std::ceil(r.x + r.w * r.cornerSizeFactor);
+        e.cornerRight = (int)std::floor(r.x + r.w * (1.0f - r.cornerSizeFactor));
+        e.cornerTop = (int)std::ceil(r.y + r.h * r.cornerSizeFactor);
+        e.cornerBottom = (int)std::floor(r.y + r.h * (1.0f - r.cornerSizeFactor));
+
+        // Numbered once merged, monitor by monitor and side by side
+        for (int side = 0; side < EdgeSideCount; side++)
+            for (EdgeSegment &segment : e.segments[side])
+                segment.index = numSegments++;
+    }
+}
+
+void MonitorLayout::addSegments(int monitor, EdgeSide side, int line, int from, int to) {
+    const bool vertical = (side == EdgeLeft || side == EdgeRight);
+    const std::vector<int> &bounds = vertical ? yBounds : xBounds;
+    std::vector<EdgeSegment> &segments = edges[monitor].segments[side];
+
+    // The neighbour can only change on a grid line
+    int start = from;
+    while (start < to) {
+        auto next = std::upper_bound(bounds.begin(), bounds.end(), start);
+        int end = (next == bounds.end()) ? to : std::min(*next, to);
+
+        int neighbour = vertical ? monitorAt(line, start) : monitorAt(start, line);
+        if (neighbour == monitor)
+            neighbour = -1;
+
+        if (!segments.empty() && segments.back().neighbour == neighbour)
+            segments.back().to = end;
+        else
+            segments.push_back(EdgeSegment{start, end, neighbour, -1});
+
+        start = end;
+    }
+}
+
+int MonitorLayout::monitorAt(int x, int y) const {
+    if (grid.empty() || x < xBounds.front() || x >= xBounds.back() || y < yBounds.front() ||
+        y >= yBounds.back())
+        return -1;
+
+    int col = std::upper_bound(xBounds.begin(), xBounds.end(), x) - xBounds.begin() - 1;
+    int row = std::upper_bound(yBounds.begin(), yBounds.end(), y) - yBounds.begin() - 1;
+    return grid[row * ((int)xBounds.size() - 1) + col];
+}
+
+const EdgeSegment &MonitorLayout::segmentAt(int monitor, EdgeSide side, int pos) const {
+    const std::vector<EdgeSegment> &segments = edges[monitor].segments[side];
+
+    // Last segment starting before pos; positions beyond the ends belong to the end segments
+    auto it = std::upper_bound(segments.begin(), segments.end(), pos,
+                               [](int p, const EdgeSegment &s) { return p < s.from; });
+    if (it != segments.begin())
+        --it;
+    return *it;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+/*
+Immutable index of the monitor layout, rebuilt whenever the monitors or the screen config change.
+Answers the questions asked on every pointer event with table lookups:
+which monitor is at a point, what lies beyond an edge, and whether a point is in a corner.
+*/
+
+enum EdgeSide { EdgeLeft = 0, EdgeRight, EdgeTop, EdgeBottom, EdgeSideCount };
+
+struct MonitorRect {
+    int x, y;
+    unsigned int w, h;
+    float cornerSizeFactor; // fraction of the width and height taken by the corners
+};
+
+// A part of a monitor edge, along which the same monitor (or none) lies on the other side
+struct EdgeSegment {
+    int from, to;  // range along the edge, [from, to)
+    int neighbour; // index of the monitor beyond the edge, -1 for a dead screen border
+    int index;     // numbers all segments of the layout from 0, for tables kept per segment
+
+    bool shared() const { return neighbour != -1; }
+};
+
+struct MonitorEdges {
+    std::vector<EdgeSegment> segments[EdgeSideCount]; // sorted, covering the whole edge
+    int cornerLeft, cornerRight;                      // x < cornerLeft or x > cornerRight
+    int cornerTop, cornerBottom;                      // y < cornerTop or y > cornerBottom
+};
+
+class MonitorLayout {
+  public:
+    void build(const std::vector<MonitorRect> &rects);
+
+    // Index of the monitor containing the point, or -1
+    int monitorAt(int x, int y) const;
+
+    // The segment of the monitor's edge at position pos along it (y for vertical edges)
+    const EdgeSegment &segmentAt(int monitor, EdgeSide side, int pos) const;
+
+    bool inCorner(int monitor, int x, int y) const {
+        const MonitorEdges &e = edges[monitor];
+        return (x < e.cornerLeft || x > e.cornerRight) && (y < e.cornerTop || y > e.cornerBottom);
+    }
+
+    const MonitorEdges &edgesOf(int monitor) const { return edges[monitor]; }
+    int size() const { return (int)edges.size(); }
+    int segmentCount() const { return numSegments; }
+
+  private:
+    void addSegments(int monitor, EdgeSide side, int line, int from, int to);
+
+    std::vector<MonitorRect> rects;
+    std::vector<MonitorEdges> edges;
+    int numSegments = 0;
+
+    // Grid made of all distinct monitor boundaries, each cell holding the monitor covering it
+    std::vector<int> xBounds, yBounds;
+    std::vector<int> grid;
+};
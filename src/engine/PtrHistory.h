@@ -0,0 +1,176 @@
+#pragma once
+
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "EventTime.h"
+
+typedef EventTime PtrTime;
+
+struct PtrSample {
+    PtrTime time;
+    float dx, dy;
+    float dist;
+};
+
+/*
+Fixed-capacity history of pointer movements, stored as separate arrays per field.
+Two sliding windows over it keep the distance moved within the last windowFor and recentFor
+seconds. Their start only moves forward, so keeping them up to date costs amortised O(1) per sample
+regardless of how long the history is.
+*/
+class PtrHistory {
+  public:
+    typedef std::chrono::duration<float> Seconds;
+
+    // Resets the history if any of the settings changed
+    void configure(int capacity, Seconds windowFor, Seconds recentFor) {
+        if (capacity == requestedCapacity && windowFor == longWin.length &&
+            recentFor == shortWin.length)
+            return;
+
+        requestedCapacity = capacity > 0 ? capacity : 1;
+        int size = 1;
+        while (size < requestedCapacity)
+            size <<= 1;
+        mask = size - 1;
+
+        times.assign(size, PtrTime());
+        dxs.assign(size, 0.0f);
+        dys.assign(size, 0.0f);
+        dists.assign(size, 0.0f);
+
+        longWin = SlidingWindow{windowFor, 0, 0.0};
+        shortWin = SlidingWindow{recentFor, 0, 0.0};
+        count = settled = 0;
+    }
+
+    void push(PtrTime time, float dx, float dy) {
+        const float dist = std::sqrt(dx * dx + dy * dy);
+
+        // Let the windows drop what falls out of them, before its slot gets reused
+        const unsigned long newCount = count + 1;
+        const unsigned long oldest =
+            newCount > (unsigned long)requestedCapacity ? newCount - requestedCapacity : 0;
+        drop(longWin, time, oldest);
+        drop(shortWin, time, oldest);
+
+        const unsigned long i = count & mask;
+        times[i] = time;
+        dxs[i] = dx;
+        dys[i] = dy;
+        dists[i] = dist;
+        count = settled = newCount;
+
+        longWin.sum += dist;
+        shortWin.sum += dist;
+    }
+
+    /*
+    Only stores the sample, for while nobody needs the speeds. settle() must be called before
+    anything else is asked or pushed.
+    */
+    void pushLater(PtrTime time, float dx, float dy) {
+        const unsigned long i = count & mask;
+        times[i] = time;
+        dxs[i] = dx;
+        dys[i] = dy;
+        count++;
+    }
+
+    // Brings the windows up to date after pushLater(). Only the samples still inside the long
+    // window are looked at
+    void settle() {
+        if (settled == count)
+            return;
+
+        const unsigned long oldest =
+            count > (unsigned long)requestedCapacity ? count - requestedCapacity : 0;
+        const PtrTime now = times[(count - 1) & mask];
+        for (unsigned long j = count; j > std::max(settled, oldest); j--) {
+            const unsigned long i = (j - 1) & mask;
+            if (now - times[i] > longWin.length)
+                break;
+            dists[i] = std::sqrt(dxs[i] * dxs[i] + dys[i] * dys[i]);
+        }
+        settled = count;
+
+        // The windows start over from the newest sample
+        for (SlidingWindow *win : {&longWin, &shortWin}) {
+            win->start = count;
+            win->sum = 0.0;
+            while (win->start > oldest && now - times[(win->start - 1) & mask] <= win->length) {
+                win->start--;
+                win->sum += dists[win->start & mask];
+            }
+        }
+    }
+
+    // Forgets all samples, e.g. when the timebase changes
+    void clear() {
+        count = settled = 0;
+        longWin.start = shortWin.start = 0;
+        longWin.sum = shortWin.sum = 0.0;
+    }
+
+    bool empty() const { return count == 0; }
+    int capacity() const { return requestedCapacity; }
+
+    PtrSample back() const {
+        if (count == 0)
+            return PtrSample{PtrTime(), 0.0f, 0.0f, 0.0f};
+        const unsigned long i = (count - 1) & mask;
+        return PtrSample{times[i], dxs[i], dys[i], dists[i]};
+    }
+
+    // Average speed in pixels per second over the long window
+    float windowSpeed() const { return speedOf(longWin); }
+
+    // Average speed in pixels per second over the short window
+    float recentSpeed() const { return speedOf(shortWin); }
+
+  private:
+    struct SlidingWindow {
+        Seconds length;
+        unsigned long start; // oldest sample inside the window
+        double sum;          // distance moved within the window
+    };
+
+    /*
+    Once the history is full, a window may have lost samples that are still inside its length.
+    Then only the time between the oldest remaining sample and the newest one is covered, and the
+    distance moved within it excludes the oldest sample's own.
+    */
+    float speedOf(const SlidingWindow &win) const {
+        if (count > (unsigned long)requestedCapacity && count - win.start > 1 &&
+            win.start == count - requestedCapacity) {
+            const Seconds covered = times[(count - 1) & mask] - times[win.start & mask];
+            if (covered > Seconds(0.0f) && covered < win.length)
+                return (win.sum - dists[win.start & mask]) / covered.count();
+        }
+        return win.sum / win.length.count();
+    }
+
+    void drop(SlidingWindow &win, PtrTime now, unsigned long oldest) {
+        while (win.start < count &&
+               (win.start < oldest || now - times[win.start & mask] > win.length)) {
+            win.sum -= dists[win.start & mask];
+            win.start++;
+        }
+        if (win.sum < 0.0)
+            win.sum = 0.0;
+    }
+
+    int requestedCapacity = 0;
+    unsigned long mask = 0;
+    unsigned long count = 0;   // number of samples pushed so far
+    unsigned long settled = 0; // ... of those, the ones the windows are up to date with
+
+    std::vector<PtrTime> times;
+    std::vector<float> dxs, dys, dists;
+
+    SlidingWindow longWin{}, shortWin{};
+};
@@ -0,0 +1,81 @@
+#include "Stats.h"
+
+const char *const statCounterNames[StatCounterCount] = {
+    "raw events",        "motion batches", "coalesced events", "confines",
+    "releases",          "passes",         "deadline passes",  "gated batches",
+    "raw motion pauses", "round-trips",    "dropped samples",
+};
+
+const char *const statStageNames[StatStageCount] = {
+    "receive to decision", "dispatch", "track", "speed", "decision", "confine",
+};
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (count == 0)
+        return 0;
+    uint64_t target = (uint64_t)(fraction * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; i++) {
+        seen += buckets[i];
+        if (seen > target)
+            return bucketUpperBound(i) < max ? bucketUpperBound(i) : max;
+    }
+    return max;
+}
+
+void Stats::share(StatsData *to, std::atomic<uint64_t> *seq) {
+    *to = data();
+    shared = to;
+    sequence = seq;
+}
+
+void Stats::unshare() {
+    local = data();
+    shared = nullptr;
+    sequence = nullptr;
+}
+
+void Stats::reset() {
+    StatsData &d = beginWrite();
+    d = StatsData();
+    endWrite();
+}
+
+void Stats::dump(FILE *out) const {
+    if (!STICKY_STATS) {
+        fprintf(out, "Statistics were not compiled in\n");
+        return;
+    }
+    dumpStatsData(data(), out);
+}
+
+void dumpStatsData(const StatsData &data, FILE *out) {
+    fprintf(out, "Counters:\n");
+    for (int i = 0; i < StatCounterCount; i++)
+        fprintf(out, "  %-20s %12llu\n", statCounterNames[i],
+                (unsigned long long)data.counters[i]);
+
+    fprintf(out, "Latencies (us):       count      mean       p50       p99       max\n");
+    for (int i = 0; i < StatStageCount; i++) {
+        const LatencyHistogram &hist = data.stages[i];
+        double mean = hist.count ? (double)hist.sum / hist.count : 0.0;
+        fprintf(out, "  %-20s %8llu %9.2f %9.2f %9.2f %9.2f\n", statStageNames[i],
+                (unsigned long long)hist.count, mean / 1000.0, hist.percentile(0.5) / 1000.0,
+                hist.percentile(0.99) / 1000.0, hist.max / 1000.0);
+    }
+
+    // The buckets themselves, for the stages that saw samples
+    for (int i = 0; i < StatStageCount; i++) {
+        const LatencyHistogram &hist = data.stages[i];
+        if (hist.count == 0)
+            continue;
+        fprintf(out, "Histogram of %s:\n", statStageNames[i]);
+        for (int b = 0; b < LatencyHistogram::bucketCount; b++) {
+            if (hist.buckets[b])
+                fprintf(out, "  <= %10.2f us %10llu\n",
+                        LatencyHistogram::bucketUpperBound(b) / 1000.0,
+                        (unsigned long long)hist.buckets[b]);
+        }
+    }
+    fflush(out);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+
+// Compiled out entirely with -DSTICKY_STATS=0
+#ifndef STICKY_STATS
+#define STICKY_STATS 1
+#endif
+
+enum StatCounter {
+    StatRawEvents,       // raw motion events received
+    StatMotionBatches,   // batches of raw motion handed to the engine
+    StatCoalesced,       // raw events merged into a batch with others
+    StatConfines,        // the pointer was confined
+    StatReleases,        // the pointer was released, for passing or a click
+    StatPasses,          // the pointer was let through an edge
+    StatDeadlinePasses,  // ... of those, when the delay expired without new events
+    StatGatedBatches,    // motion batches skipped, too far from any shared edge to matter
+    StatRawMotionPauses, // raw motion was deselected while far from the edges
+    StatRoundTrips,      // synchronous X requests
+    StatDroppedSamples,  // raw motion events lost, the input queue was full
+    StatCounterCount
+};
+
+enum StatStage {
+    StageLatency,  // from receiving the first raw event of a batch to the end of its decision
+    StageDispatch, // handling one X event
+    StageTrack,    // resolving the pointer position
+    StageSpeed,    // updating the movement history and speeds
+    StageDecision, // deciding whether to hold the pointer or let it through
+    StageConfine,  // confining and warping the pointer
+    StatStageCount
+};
+
+/*
+Latency histogram with fixed buckets: two per power of two nanoseconds, up to 2^40 ns, ~18 minutes.
+Longer ones go in the last bucket. Recording is a couple of bit operations and increments.
+*/
+class LatencyHistogram {
+  public:
+    static const int bucketCount = 80;
+
+    void record(uint64_t ns) {
+        buckets[bucketOf(ns)]++;
+        count++;
+        sum += ns;
+        if (ns > max)
+            max = ns;
+    }
+
+    // Upper bound of the bucket holding the given fraction of the samples
+    uint64_t percentile(double fraction) const;
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < 2)
+            return (int)ns;
+        int msb = 63 - __builtin_clzll(ns);
+        int bucket = msb * 2 + (int)((ns >> (msb - 1)) & 1);
+        return bucket < bucketCount ? bucket : bucketCount - 1;
+    }
+    static uint64_t bucketUpperBound(int bucket) {
+        if (bucket < 2)
+            return bucket;
+        int msb = bucket / 2;
+        return (((uint64_t)(2 | (bucket & 1)) + 1) << (msb - 1)) - 1;
+    }
+
+    uint64_t buckets[bucketCount] = {};
+    uint64_t count = 0, sum = 0, max = 0;
+};
+
+// The counters and histograms themselves. Plain data, so it can live in shared memory
+struct StatsData {
+    uint64_t counters[StatCounterCount] = {};
+    LatencyHistogram stages[StatStageCount];
+};
+
+/*
+Counters and stage latencies of the daemon. Everything is a no-op while disabled, which costs a
+predictable branch, and is removed by the compiler when STICKY_STATS is 0.
+
+The data is kept in the object until share() moves it elsewhere, e.g. into a mapped file. Shared
+data is updated under a seqlock: the sequence is odd while an update is in progress, so readers
+can copy it without ever making the writer wait. There must only be one writer.
+*/
+class Stats {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    bool active() const { return STICKY_STATS && enabled; }
+
+    void count(StatCounter counter, uint64_t n = 1) {
+        if (active()) {
+            StatsData &d = beginWrite();
+            d.counters[counter] += n;
+            endWrite();
+        }
+    }
+
+    void record(StatStage stage, Clock::time_point start) {
+        if (active()) {
+            uint64_t ns =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            StatsData &d = beginWrite();
+            d.stages[stage].record(ns);
+            endWrite();
+        }
+    }
+
+    // A start time for record(), without reading the clock while disabled
+    Clock::time_point start() const { return active() ? Clock::now() : Clock::time_point(); }
+
+    // Moves the data to the given place, from then on updated under the given sequence
+    void share(StatsData *to, std::atomic<uint64_t> *seq);
+    void unshare();
+
+    const StatsData &data() const { return shared ? *shared : local; }
+
+    void reset();
+    void dump(FILE *out) const;
+
+    bool enabled = false;
+
+  private:
+    StatsData &beginWrite() {
+        if (sequence) {
+            sequence->store(sequence->load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        return shared ? *shared : local;
+    }
+    void endWrite() {
+        if (sequence)
+            sequence->store(sequence->load(std::memory_order_relaxed) + 1,
+                            std::memory_order_release);
+    }
+
+    StatsData local;
+    StatsData *shared = nullptr;
+    std::atomic<uint64_t> *sequence = nullptr;
+};
+
+// Prints the counters and histograms
+void dumpStatsData(const StatsData &data, FILE *out);
+
+// Times a scope as one stage
+class StageTimer {
+  public:
+    StageTimer(Stats &stats, StatStage stage) : stats(stats), stage(stage), begin(stats.start()) {}
+    ~StageTimer() { stats.record(stage, begin); }
+
+  private:
+    Stats &stats;
+    StatStage stage;
+    Stats::Clock::time_point begin;
+};
+
+extern const char *const statCounterNames[StatCounterCount];
+extern const char *const statStageNames[StatStageCount];
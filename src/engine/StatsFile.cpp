@@ -0,0 +1,140 @@
+#include "StatsFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <new>
+
+std::string defaultStatsPath() {
+    const char *env = getenv("XDG_RUNTIME_DIR");
+    if (env != nullptr && env[0] != '\0')
+        return std::string(env) + "/sticky-mouse-trap.stats";
+    return "";
+}
+
+bool StatsPublisher::open(const std::string &path, Stats *stats) {
+    close();
+
+    // Written under a new, unique name and renamed, so readers never see a half-made header and
+    // nothing already in the directory is followed or overwritten
+    std::string tmpPath = path + ".XXXXXX";
+    int fd = mkostemp(&tmpPath[0], O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    void *mem = MAP_FAILED;
+    if (ftruncate(fd, sizeof(StatsFileLayout)) == 0)
+        mem = mmap(nullptr, sizeof(StatsFileLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    file = new (mem) StatsFileLayout();
+    StatsFileHeader &header = file->header;
+    memcpy(header.magic, "SMTSTATS", 8);
+    header.version = statsFileVersion;
+    header.size = sizeof(StatsFileLayout);
+    header.counterCount = StatCounterCount;
+    header.stageCount = StatStageCount;
+    header.bucketCount = LatencyHistogram::bucketCount;
+    header.pid = getpid();
+    header.enabled = stats->enabled;
+    header.sequence = 0;
+    stats->share(&file->data, &header.sequence);
+
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        stats->unshare();
+        munmap(file, sizeof(StatsFileLayout));
+        file = nullptr;
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    this->stats = stats;
+    this->path = path;
+    return true;
+}
+
+void StatsPublisher::close() {
+    if (file == nullptr)
+        return;
+    stats->unshare();
+    munmap(file, sizeof(StatsFileLayout));
+    unlink(path.c_str());
+    file = nullptr;
+    stats = nullptr;
+}
+
+void StatsPublisher::setEnabled(bool enabled) {
+    if (file != nullptr)
+        file->header.enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool StatsReader::open(const std::string &path, std::string *error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        *error = std::string("cannot open: ") + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(StatsFileHeader)) {
+        ::close(fd);
+        *error = "not a statistics file";
+        return false;
+    }
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        *error = std::string("cannot map: ") + strerror(errno);
+        return false;
+    }
+    file = (const StatsFileLayout *)mem;
+    mappedSize = st.st_size;
+
+    const StatsFileHeader &h = file->header;
+    if (memcmp(h.magic, "SMTSTATS", 8) != 0)
+        *error = "not a statistics file";
+    else if (h.version != statsFileVersion)
+        *error = "version " + std::to_string(h.version) + ", expected " +
+                 std::to_string(statsFileVersion);
+    else if (h.size != sizeof(StatsFileLayout) || mappedSize < sizeof(StatsFileLayout) ||
+             h.counterCount != StatCounterCount || h.stageCount != StatStageCount ||
+             h.bucketCount != LatencyHistogram::bucketCount)
+        *error = "unexpected layout";
+    else
+        return true;
+
+    close();
+    return false;
+}
+
+void StatsReader::close() {
+    if (file == nullptr)
+        return;
+    munmap((void *)file, mappedSize);
+    file = nullptr;
+    mappedSize = 0;
+}
+
+bool StatsReader::read(StatsData *data) const {
+    const std::atomic<uint64_t> &sequence = file->header.sequence;
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        memcpy((void *)data, (const void *)&file->data, sizeof(StatsData));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "Stats.h"
+
+/*
+Statistics published in a memory-mapped file, for monitoring tools that can't parse the output.
+
+The file is a StatsFileLayout in native byte order: the header, then the StatsData the daemon
+updates in place. Updating costs no system calls, and readers copy the data under the header's
+seqlock, so they never make the daemon wait. The version changes whenever the layout does.
+*/
+
+const uint32_t statsFileVersion = 3;
+
+struct StatsFileHeader {
+    char magic[8];                  // "SMTSTATS"
+    uint32_t version;               // statsFileVersion
+    uint32_t size;                  // of the whole file
+    uint32_t counterCount;          // StatCounterCount
+    uint32_t stageCount;            // StatStageCount
+    uint32_t bucketCount;           // LatencyHistogram::bucketCount
+    int32_t pid;                    // of the daemon
+    std::atomic<uint32_t> enabled;  // whether the daemon is collecting
+    uint32_t reserved;
+    std::atomic<uint64_t> sequence; // odd while the data is being updated
+};
+
+struct StatsFileLayout {
+    StatsFileHeader header;
+    StatsData data;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == 8 && sizeof(std::atomic<uint32_t>) == 4,
+              "the atomics must be plain integers to be shared between processes");
+
+// $XDG_RUNTIME_DIR/sticky-mouse-trap.stats, or empty when that isn't set. A shared directory
+// like /tmp would let other users plant the file
+std::string defaultStatsPath();
+
+class StatsPublisher {
+  public:
+    ~StatsPublisher() { close(); }
+
+    // Creates the file, readable by the user only, and moves the statistics into it
+    bool open(const std::string &path, Stats *stats);
+    // Moves the statistics back and removes the file
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    void setEnabled(bool enabled);
+
+  private:
+    StatsFileLayout *file = nullptr;
+    Stats *stats = nullptr;
+    std::string path;
+};
+
+class StatsReader {
+  public:
+    ~StatsReader() { close(); }
+
+    bool open(const std::string &path, std::string *error);
+    void close();
+
+    const StatsFileHeader &header() const { return file->header; }
+    // Copies a consistent snapshot. Fails if the daemon kept updating the data while copying
+    bool read(StatsData *data) const;
+
+  private:
+    const StatsFileLayout *file = nullptr;
+    size_t mappedSize = 0;
+};
@@ -0,0 +1,229 @@
+#include "Trace.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+const char traceMagic[8] = {'S', 'M', 'T', 'T', 'R', 'A', 'C', 'E'};
+const size_t traceHeaderSize = sizeof(traceMagic) + 4;
+
+uint32_t floatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+float bitsFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+} // namespace
+
+/*
+Writing
+*/
+bool TraceWriter::open(const std::string &path) {
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    // Records are small, so let stdio gather them
+    setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    fwrite(traceMagic, 1, sizeof(traceMagic), file);
+    put32(traceVersion);
+    lastTime = EventTime();
+    return true;
+}
+
+void TraceWriter::close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void TraceWriter::putVarint(uint64_t value) {
+    unsigned char buf[10];
+    int len = 0;
+    do {
+        buf[len] = value & 0x7f;
+        value >>= 7;
+        if (value)
+            buf[len] |= 0x80;
+        len++;
+    } while (value);
+    fwrite(buf, 1, len, file);
+}
+
+void TraceWriter::put32(uint32_t value) {
+    unsigned char buf[4] = {(unsigned char)value, (unsigned char)(value >> 8),
+                            (unsigned char)(value >> 16), (unsigned char)(value >> 24)};
+    fwrite(buf, 1, 4, file);
+}
+
+void TraceWriter::begin(TraceRecordType type, EventTime time) {
+    int64_t dt = (time - lastTime).count();
+    lastTime = time;
+    fputc(type, file);
+    putVarint(((uint64_t)dt << 1) ^ (uint64_t)(dt >> 63));
+}
+
+void TraceWriter::motion(EventTime time, float dx, float dy, bool batchEnd) {
+    if (!file)
+        return;
+    begin(TraceMotion, time);
+    put32(floatBits(dx));
+    put32(floatBits(dy));
+    fputc(batchEnd ? 1 : 0, file);
+}
+
+void TraceWriter::button(EventTime time, int button, bool pressed, int x, int y) {
+    if (!file)
+        return;
+    begin(TraceButton, time);
+    fputc(button, file);
+    fputc(pressed ? 1 : 0, file);
+    put32((uint32_t)x);
+    put32((uint32_t)y);
+}
+
+void TraceWriter::layout(const std::vector<Monitor> &monitors, int pointerX, int pointerY) {
+    if (!file)
+        return;
+    begin(TraceLayout, lastTime);
+    put32((uint32_t)pointerX);
+    put32((uint32_t)pointerY);
+    fputc(monitors.size() & 0xff, file);
+    fputc((monitors.size() >> 8) & 0xff, file);
+    for (const Monitor &mon : monitors) {
+        put32((uint32_t)mon.id);
+        put32((uint32_t)mon.x);
+        put32((uint32_t)mon.y);
+        put32(mon.w);
+        put32(mon.h);
+        size_t length = std::min(mon.name.size(), (size_t)255);
+        fputc((int)length, file);
+        fwrite(mon.name.data(), 1, length, file);
+    }
+}
+
+/*
+Reading
+*/
+bool TraceReader::open(const std::string &path) {
+    data.clear();
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    unsigned char buf[1 << 16];
+    size_t numRead;
+    while ((numRead = fread(buf, 1, sizeof(buf), file)) > 0)
+        data.insert(data.end(), buf, buf + numRead);
+    fclose(file);
+
+    if (data.size() < traceHeaderSize || memcmp(data.data(), traceMagic, sizeof(traceMagic)) != 0)
+        return false;
+    pos = sizeof(traceMagic);
+    get32(&version);
+    if (version < 1 || version > traceVersion)
+        return false;
+
+    rewind();
+    return true;
+}
+
+void TraceReader::rewind() {
+    pos = traceHeaderSize;
+    lastTime = EventTime();
+}
+
+bool TraceReader::getVarint(uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= data.size())
+            return false;
+        unsigned char byte = data[pos++];
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool TraceReader::get32(uint32_t *value) {
+    if (data.size() - pos < 4)
+        return false;
+    const unsigned char *p = &data[pos];
+    *value = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    pos += 4;
+    return true;
+}
+
+bool TraceReader::next(TraceRecord *rec) {
+    if (pos >= data.size())
+        return false;
+    rec->type = (TraceRecordType)data[pos++];
+
+    uint64_t zigzag;
+    if (!getVarint(&zigzag))
+        return false;
+    int64_t dt = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+    lastTime += EventClock::duration(dt);
+    rec->time = lastTime;
+
+    uint32_t a, b;
+    switch (rec->type) {
+    case TraceMotion:
+        if (!get32(&a) || !get32(&b))
+            return false;
+        rec->dx = bitsFloat(a);
+        rec->dy = bitsFloat(b);
+        rec->batchEnd = true;
+        if (version >= 3) {
+            if (pos >= data.size())
+                return false;
+            rec->batchEnd = data[pos++] != 0;
+        }
+        return true;
+    case TraceButton:
+        if (data.size() - pos < 2)
+            return false;
+        rec->button = data[pos++];
+        rec->pressed = data[pos++] != 0;
+        if (!get32(&a) || !get32(&b))
+            return false;
+        rec->x = (int32_t)a;
+        rec->y = (int32_t)b;
+        return true;
+    case TraceLayout: {
+        if (!get32(&a) || !get32(&b) || data.size() - pos < 2)
+            return false;
+        rec->x = (int32_t)a;
+        rec->y = (int32_t)b;
+        int count = data[pos] | (data[pos + 1] << 8);
+        pos += 2;
+        rec->monitors.clear();
+        for (int i = 0; i < count; i++) {
+            uint32_t id, x, y, w, h;
+            if (!get32(&id) || !get32(&x) || !get32(&y) || !get32(&w) || !get32(&h))
+                return false;
+            Monitor mon{(int32_t)id, (int32_t)x, (int32_t)y, w, h, std::string()};
+            if (version >= 2) {
+                if (pos >= data.size() || data.size() - pos - 1 < data[pos])
+                    return false;
+                mon.name.assign((const char *)&data[pos + 1], data[pos]);
+                pos += 1 + data[pos];
+            }
+            rec->monitors.push_back(mon);
+        }
+        return true;
+    }
+    }
+    return false;
+}
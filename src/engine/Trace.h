@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "EventTime.h"
+#include "Monitor.h"
+
+/*
+Binary recording of everything the engine was fed, for replaying it offline.
+
+The file starts with the magic "SMTTRACE" and a little-endian uint32 version, followed by records.
+Each record is a type byte and the time since the previous record in microseconds, as a zigzag
+LEB128 varint (event times may go back slightly), followed by the type's fields:
+    TraceMotion: float32 dx, dy, uint8 1 if it's the last motion of its batch, else 0
+    TraceButton: uint8 button, uint8 pressed, int32 x, y
+    TraceLayout: int32 pointer x, y, uint16 monitor count, then int32 id, x, y, uint32 w, h,
+                 uint8 name length and the name each
+All multi-byte fields are little-endian. A batch is the motion the engine was handed at once.
+Older versions are still read: version 2 without the batches, where every motion is a batch of
+its own, and version 1 also without the monitor names.
+*/
+
+const uint32_t traceVersion = 3;
+
+enum TraceRecordType : uint8_t { TraceMotion = 1, TraceButton = 2, TraceLayout = 3 };
+
+struct TraceRecord {
+    TraceRecordType type;
+    EventTime time;
+
+    // TraceMotion
+    float dx, dy;
+    bool batchEnd; // the engine was handed the motion up to here at once
+
+    // TraceButton, and the pointer position for TraceLayout
+    int button;
+    bool pressed;
+    int x, y;
+
+    // TraceLayout
+    std::vector<Monitor> monitors;
+};
+
+class TraceWriter {
+  public:
+    ~TraceWriter() { close(); }
+
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    void motion(EventTime time, float dx, float dy, bool batchEnd);
+    void button(EventTime time, int button, bool pressed, int x, int y);
+    // Layouts are stamped with the time of the previous record
+    void layout(const std::vector<Monitor> &monitors, int pointerX, int pointerY);
+
+  private:
+    void begin(TraceRecordType type, EventTime time);
+    void putVarint(uint64_t value);
+    void put32(uint32_t value);
+
+    FILE *file = nullptr;
+    EventTime lastTime;
+};
+
+class TraceReader {
+  public:
+    // Reads the whole file. Returns false if it can't be read or isn't a trace
+    bool open(const std::string &path);
+
+    // Returns false at the end of the trace, or if the rest is corrupt
+    bool next(TraceRecord *rec);
+
+    // Starts over from the first record
+    void rewind();
+
+    // All records were read
+    bool atEnd() const { return pos >= data.size(); }
+
+  private:
+    bool getVarint(uint64_t *value);
+    bool get32(uint32_t *value);
+
+    std::vector<unsigned char> data;
+    size_t pos = 0;
+    uint32_t version = 0;
+    EventTime lastTime;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+#include "EventTime.h"
+
+/*
+Constant-acceleration tracker of the pointer's intended motion, fed with the raw deltas, so it's
+unaffected by the pointer being held at an edge. An alpha-beta-gamma filter, the steady-state form
+of a Kalman filter for this motion model: each sample costs a few multiplications per axis,
+whatever the event rate.
+*/
+class TrajectoryFilter {
+  public:
+    // Forgets the motion so far, e.g. after a pause
+    void reset() {
+        started = false;
+        offsetX = offsetY = vx = vy = ax = ay = 0.0f;
+        pendingDx = pendingDy = 0.0f;
+    }
+
+    void push(EventTime time, float dx, float dy) {
+        // The trajectory starts at the first sample
+        if (!started) {
+            started = true;
+            lastTime = time;
+            return;
+        }
+        pendingDx += dx;
+        pendingDy += dy;
+
+        // Events within the same timestamp are taken together
+        const float dt = std::chrono::duration<float>(time - lastTime).count();
+        if (dt <= 0.0f)
+            return;
+        lastTime = time;
+
+        // A pause breaks the trajectory
+        if (dt > maxGap) {
+            offsetX = offsetY = vx = vy = ax = ay = 0.0f;
+            pendingDx = pendingDy = 0.0f;
+            return;
+        }
+
+        // The estimate is kept relative to the measured position, which keeps the floats small
+        update(pendingDx, dt, &vx, &ax, &offsetX);
+        update(pendingDy, dt, &vy, &ay, &offsetY);
+        pendingDx = pendingDy = 0.0f;
+    }
+
+    // Estimated velocity and acceleration, in pixels per second and per second squared
+    float velocityX() const { return vx; }
+    float velocityY() const { return vy; }
+    float accelerationX() const { return ax; }
+    float accelerationY() const { return ay; }
+
+    /*
+    How far the pointer would travel along the direction (nx, ny) of unit length within the next
+    horizon seconds, if it keeps slowing down as now, or keeps its speed. Speeding up isn't
+    extrapolated, as the acceleration is the noisiest of the estimates.
+    */
+    float travel(float nx, float ny, float horizon) const {
+        const float v = vx * nx + vy * ny;
+        const float a = std::min(ax * nx + ay * ny, 0.0f);
+        if (v <= 0.0f)
+            return 0.0f;
+        if (a < 0.0f && v < -a * horizon)
+            return v * v / (-2.0f * a); // comes to rest before
+        return v * horizon + 0.5f * a * horizon * horizon;
+    }
+
+  private:
+    // Gains of the filter. Smaller ones smooth more, but follow changes of pace later
+    static constexpr float alpha = 0.5f, beta = 0.15f, gamma = 0.01f;
+    static constexpr float maxGap = 0.05f; // seconds without motion that end a trajectory
+
+    // One axis: moved by the measured distance since the last estimate, over dt seconds
+    static void update(float moved, float dt, float *v, float *a, float *offset) {
+        const float predicted = *offset + *v * dt + 0.5f * *a * dt * dt;
+        const float residual = moved - predicted;
+        *v += *a * dt + beta * residual / dt;
+        *a += 2.0f * gamma * residual / (dt * dt);
+        *offset = (predicted + alpha * residual) - moved;
+    }
+
+    bool started = false;
+    EventTime lastTime;
+    float offsetX = 0.0f, offsetY = 0.0f; // estimated position, relative to the measured one
+    float vx = 0.0f, vy = 0.0f;
+    float ax = 0.0f, ay = 0.0f;
+    float pendingDx = 0.0f, pendingDy = 0.0f; // motion not taken into the estimate yet
+};
@@ -0,0 +1,79 @@
+#include "FakeBackend.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+void FakeBackend::setScreen(const std::vector<Monitor> &newMonitors, int resistanceMargins) {
+    monitors = newMonitors;
+    margins = resistanceMargins;
+}
+
+void FakeBackend::move(double dx, double dy) {
+    double x = pointerX + dx, y = pointerY + dy;
+
+    if (confined) {
+        x = std::max((double)confinedTo.x + margins,
+                     std::min(x, (double)confinedTo.x + confinedTo.w - margins - 1));
+        y = std::max((double)confinedTo.y + margins,
+                     std::min(y, (double)confinedTo.y + confinedTo.h - margins - 1));
+    } else if (!onMonitor(x, y)) {
+        // The server doesn't let the pointer into areas no monitor shows, but lets it slide
+        // along their borders
+        if (onMonitor(x, pointerY))
+            y = pointerY;
+        else if (onMonitor(pointerX, y))
+            x = pointerX;
+        else {
+            x = pointerX;
+            y = pointerY;
+        }
+    }
+
+    pointerX = x;
+    pointerY = y;
+}
+
+bool FakeBackend::onMonitor(double x, double y) const {
+    for (const Monitor &mon : monitors)
+        if (mon.contains((int)std::floor(x), (int)std::floor(y)))
+            return true;
+    return false;
+}
+
+bool FakeBackend::takeDeadline(EventTime until) {
+    if (!deadlineArmed || deadline > until)
+        return false;
+    deadlineArmed = false;
+    return true;
+}
+
+void FakeBackend::queryPointer(DeviceId, int *x, int *y) {
+    queries++;
+    *x = (int)std::floor(pointerX);
+    *y = (int)std::floor(pointerY);
+}
+
+void FakeBackend::warpPointer(DeviceId, int x, int y) {
+    warps++;
+    pointerX = x;
+    pointerY = y;
+}
+
+void FakeBackend::confine(DeviceId, const Monitor &mon) {
+    confines++;
+    confined = true;
+    confinedTo = mon;
+}
+
+void FakeBackend::release(DeviceId) {
+    releases++;
+    confined = false;
+}
+
+void FakeBackend::armDeadline(DeviceId, std::chrono::duration<float> delay) {
+    deadlineArmed = true;
+    deadline = now + std::chrono::duration_cast<EventClock::duration>(delay);
+}
+
+void FakeBackend::disarmDeadline(DeviceId) { deadlineArmed = false; }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "Backend.h"
+#include "EventTime.h"
+
+/*
+In-memory stand-in for a window system. It moves a simulated pointer the way the X server would,
+keeping it on the monitors and inside the confined one, and counts what the engine asked for.
+Time is virtual: whoever drives the engine sets now before each call and collects the expired
+deadlines with takeDeadline(). There is a single pointer, whatever device the engine names.
+*/
+class FakeBackend : public Backend {
+  public:
+    // The monitors the pointer can move on, and the margins kept while confined
+    void setScreen(const std::vector<Monitor> &monitors, int resistanceMargins);
+
+    // Moves the pointer by raw deltas, clamped like the server would
+    void move(double dx, double dy);
+
+    // Returns true, once, if the armed deadline expired by the given time
+    bool takeDeadline(EventTime until);
+
+    void queryPointer(DeviceId device, int *x, int *y) override;
+    void warpPointer(DeviceId device, int x, int y) override;
+    void confine(DeviceId device, const Monitor &mon) override;
+    void release(DeviceId device) override;
+    void armDeadline(DeviceId device, std::chrono::duration<float> delay) override;
+    void disarmDeadline(DeviceId device) override;
+
+    // The device to drive the engine with, numbered like the X virtual core pointer
+    static const DeviceId device = 2;
+
+    double pointerX = 0.0, pointerY = 0.0;
+    bool confined = false;
+    Monitor confinedTo{NoMonitor, 0, 0, 0, 0};
+    EventTime now; // the virtual clock
+    bool deadlineArmed = false;
+    EventTime deadline;
+
+    // How often the engine called each function
+    unsigned long queries = 0, warps = 0, confines = 0, releases = 0;
+
+  private:
+    bool onMonitor(double x, double y) const;
+
+    std::vector<Monitor> monitors;
+    int margins = 0;
+};
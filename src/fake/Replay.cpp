@@ -0,0 +1,104 @@
+#include "Replay.h"
+
+#include "Engine.h"
+#include "FakeBackend.h"
+
+namespace {
+
+class ReplayBackend : public FakeBackend {
+  public:
+    explicit ReplayBackend(ReplayListener *listener) : listener(listener) {}
+
+    void confine(DeviceId device, const Monitor &mon) override {
+        FakeBackend::confine(device, mon);
+        listener->confined(now, mon.id);
+    }
+    void release(DeviceId device) override {
+        FakeBackend::release(device);
+        listener->released(now);
+    }
+
+  private:
+    ReplayListener *listener;
+};
+
+} // namespace
+
+bool loadTrace(const std::string &path, std::vector<TraceRecord> *records) {
+    TraceReader reader;
+    if (!reader.open(path))
+        return false;
+
+    records->clear();
+    TraceRecord rec;
+    while (reader.next(&rec))
+        records->push_back(rec);
+    return reader.atEnd();
+}
+
+unsigned long replayTrace(const std::vector<TraceRecord> &records, const EngineConfig &cfg,
+                          ReplayListener *listener) {
+    ReplayBackend backend(listener);
+    Engine engine(backend);
+    engine.configure(cfg);
+
+    std::vector<MotionSample> batch;
+    for (size_t r = 0; r < records.size(); r++) {
+        const TraceRecord &rec = records[r];
+
+        // Motion goes to the engine in the batches the daemon handed it over in
+        if (rec.type == TraceMotion) {
+            batch.push_back(MotionSample{rec.time, rec.dx, rec.dy});
+            if (!rec.batchEnd && r + 1 < records.size() && records[r + 1].type == TraceMotion)
+                continue;
+        }
+
+        // Deadlines that expired before this event, or before the batch began
+        EventTime deadline = backend.deadline;
+        if (backend.takeDeadline(batch.empty() ? rec.time : batch.front().time)) {
+            backend.now = deadline;
+            MonitorId before = engine.currentMonitor(backend.device);
+            unsigned long passes = engine.passCount(backend.device);
+            engine.deadlineExpired(backend.device);
+            if (engine.passCount(backend.device) != passes)
+                listener->passed(deadline, before, engine.currentMonitor(backend.device), true);
+        }
+
+        // Only the engine's decisions to pass count, not every change of monitor, e.g. across
+        // edges it never held or after a resync
+        backend.now = rec.time;
+        MonitorId before = engine.currentMonitor(backend.device);
+        unsigned long passes = engine.passCount(backend.device);
+        switch (rec.type) {
+        case TraceMotion:
+            for (const MotionSample &sample : batch)
+                backend.move(sample.dx, sample.dy);
+            engine.motion(backend.device, batch.data(), (int)batch.size());
+            batch.clear();
+            break;
+        case TraceButton: {
+            // Like the daemon, which only sees buttons while it holds the pointer
+            engine.unconfine(backend.device);
+            backend.pointerX = rec.x;
+            backend.pointerY = rec.y;
+            int x = rec.x, y = rec.y;
+            if (const Monitor *mon = engine.getMonitor(engine.currentMonitor(backend.device)))
+                mon->snapPosition(&x, &y, cfg.resistanceMargins);
+            engine.pointerAt(backend.device, x, y);
+            break;
+        }
+        case TraceLayout:
+            backend.pointerX = rec.x;
+            backend.pointerY = rec.y;
+            backend.setScreen(rec.monitors, cfg.resistanceMargins);
+            engine.setMonitors(rec.monitors);
+            listener->layout(rec.time, rec.monitors);
+            continue;
+        }
+
+        if (engine.passCount(backend.device) != passes)
+            listener->passed(rec.time, before, engine.currentMonitor(backend.device), false);
+    }
+
+    return records.size();
+}
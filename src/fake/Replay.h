@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "EngineConfig.h"
+#include "Monitor.h"
+#include "Trace.h"
+
+// Told about every decision the engine makes during a replay
+class ReplayListener {
+  public:
+    virtual ~ReplayListener() {}
+
+    virtual void layout(EventTime time, const std::vector<Monitor> &monitors) {}
+    virtual void confined(EventTime time, MonitorId monitor) {}
+    virtual void released(EventTime time) {}
+    // The engine let the pointer through an edge, not just any change of monitor
+    virtual void passed(EventTime time, MonitorId from, MonitorId to, bool onDeadline) {}
+};
+
+// Reads all records of a trace file. Returns false if it can't be read or is corrupt
+bool loadTrace(const std::string &path, std::vector<TraceRecord> *records);
+
+/*
+Runs the records through a new engine on the fake backend, with the clock taken from the trace.
+Deadlines that expire between two records fire at their own time. Returns the number of records
+handled.
+*/
+unsigned long replayTrace(const std::vector<TraceRecord> &records, const EngineConfig &cfg,
+                          ReplayListener *listener);
@@ -1,113 +1,147 @@
 #include <MiIni.h>
-#include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/Xfixes.h>
 #include <X11/extensions/XInput.h>
 #include <X11/extensions/XInput2.h>
 #include <X11/extensions/Xrandr.h>
-#include <circular_queue.h>
+#include <errno.h>
 #include <linux/limits.h>
-#include <math.h>
-#include <poll.h>
 #include <pwd.h>
 #include <signal.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <chrono>
-#include <iostream>
+#include <mutex>
+#include <thread>
 #include <vector>
 
-using namespace std::chrono;
-
-struct PtrEntry {
-    PtrEntry(int x, int y, float speed, float dx, float dy)
-        : x(x), y(y), speed(speed), dx(dx), dy(dy) {
-        moveTimepoint = high_resolution_clock::now();
-    }
+#include "ActiveWindow.h"
+#include "Engine.h"
+#include "EventTime.h"
+#include "InputThread.h"
+#include "Log.h"
+#include "PointerDevices.h"
+#include "Snapshot.h"
+#include "StatsFile.h"
+#include "Trace.h"
+#include "WindowCache.h"
+#include "X11Backend.h"
+#if STICKY_XCB
+#include "XcbBackend.h"
+#endif
 
-    int x, y;
-    float dx, dy;
-    float speed;
-    time_point<high_resolution_clock> moveTimepoint;
-};
+using namespace std::chrono;
 
-struct PassConfig {
-    bool always;
-    duration<float> maxDelay, minDelay, baseDelay;
-    duration<float> returnBefore;
+/*
+Everything read from the config file, as an immutable snapshot. A new one is read and checked
+on the control thread for every change of the file, then swapped in as a whole.
+*/
+struct DaemonConfig {
+    EngineConfig engine;
+    bool serverTimebase = true;
+    bool reportRoundTrips = false;
+    bool coalesceMotion = true;
+    bool pauseRawMotion = false; // while gated, with barriers and not threaded
+    bool useBarriers = false;
+    bool statsEnabled = false;
+    bool threaded = false; // only read at startup
+    LogLevel logLevel = LogInfo;
 };
 
 /*
 Config variables
 */
 std::string cfgPath;
-bool cfgSavedByMyself;
+std::string recordPath; // --record: where to write the trace of the input
 MiIni<std::string> config;
-bool cfgEnabled;
-int cfgPtrInputsToRemember;
-duration<float> cfgPtrRememberForSeconds;
-float cfgResistanceSlowdownExponent;
-float cfgResistanceSpeedupExponent;
-float cfgResistanceConstSpeedExponent;
-float cfgResistanceDirectionExponent;
-float cfgPassthroughSmoothingFactor;
-PassConfig cfgEdgePass, cfgCornerPass;
-float cfgCornerSizeFactor;
-int cfgResistanceMargins;
+SnapshotCell<DaemonConfig> configs;
+const DaemonConfig *loadedCfg; // the latest snapshot, on the control thread
+const DaemonConfig *activeCfg; // the snapshot in effect, on the decision thread
 
 /*
 Config monitor variables
 */
 int inotifyFD;
-int inotifyCfgW;
+int inotifyCfgW; // on the config's directory, as editors often replace the file
+std::string cfgFileName;
 
 /*
 Display variables
 */
-struct Monitor {
-    int x, y;
-    unsigned int w, h;
-    Window inputWindow;
+Display *display;        // our display
+Window rootWindow;       // root wnd of our display
+int xiExtOpcode;         // XInput extension opcode, to recognize its events
+int xrrEventBase;        // Xrandr event base, to recognize its events
+bool monitorsChanged;    // RandR reported a change we didn't apply yet
+bool rawMotionPaused;    // XI_RawMotion is deselected while all pointers are gated
+EventMasks eventMasks;   // what we select on each window
+WindowCache windowCache; // for finding where to replay clicks
+bool windowCacheMissed;  // a click had to ask the server, rebuild the cache after the batch
+ActiveWindow activeWindow; // for the app rules
+PointerDevices pointerDevices; // how to read their raw motion, unless in threaded mode
 
-    bool contains(int xpos, int ypos, int margin = 0) {
-        return (xpos >= x + margin && xpos < (x + w - margin) && ypos >= y + margin &&
-                ypos < (y + h - margin));
-    }
+/*
+Decision variables
+*/
+#if STICKY_XCB
+XcbBackend backend; // pipelines its requests on the XCB connection
+#else
+X11Backend backend;
+#endif
+Engine engine(backend);
+ServerTimeExtender serverTime; // for the server timebase
+TraceWriter trace;             // recording of the input, if asked for
+StatsPublisher statsFile;      // the statistics, for monitoring tools
+time_point<high_resolution_clock> lastRoundTripReport;
 
-    void snapPosition(int *xpos, int *ypos) {
-        if (*xpos < x + cfgResistanceMargins)
-            *xpos = x + cfgResistanceMargins;
-        if (*ypos < y + cfgResistanceMargins)
-            *ypos = y + cfgResistanceMargins;
-        if (*xpos > x + w - cfgResistanceMargins - 1)
-            *xpos = x + w - cfgResistanceMargins - 1;
-        if (*ypos > y + h - cfgResistanceMargins - 1)
-            *ypos = y + h - cfgResistanceMargins - 1;
-    }
+/*
+Threaded mode variables. The input thread reads raw motion on its own connection, the decision
+thread handles it along with the events of the main connection, and the main thread becomes the
+control thread, reading the config and handling signals. New configs are picked up from the
+snapshot cell, other requests from the control thread go through the mailbox.
+*/
+struct Mailbox {
+    std::mutex mutex;
+    bool dumpStats = false;
+    bool tick = false;
 };
-
-Display *display;  // our display
-Window rootWindow; // root wnd of our display
-std::vector<Monitor> monitors;
-Monitor *currentMonitor; // the monitor in which the pointer is
+bool threadedMode; // fixed at startup
+InputThread inputThread;
+std::thread decisionThread;
+Mailbox mailbox;
+int wakeFD; // eventfd waking the decision thread for new input or requests
 
 /*
-Resistance calculation variables
+Motion coalescing variables
 */
-circular_queue<PtrEntry> ptrMemory; // ptr positions and data
-bool onEdge;                        // are we on edge rn
-PassConfig *lastPassCfg;
-time_point<high_resolution_clock> touchedEdgeTime; // the time point when we touched the edge, to
-                                                   // detect delay
-time_point<high_resolution_clock>
-    brokeFromTimepoint; // the time point when we last broke from a monitor
-Time lastPtrMoveX11Time;
-Monitor *brokeFromMonitor; // the monitor we passed FROM last time. Useful for
-                           // returning to previous monitor when we miss a
-                           // button or smthng.
+struct QueuedMotion {
+    Time time;
+    double dx, dy;
+};
+struct MotionBatch {
+    int deviceid;
+    bool absolute; // from an absolute device, so the position must be asked
+    std::vector<QueuedMotion> samples;
+    Stats::Clock::time_point received; // when the first sample arrived
+    Time flushedXTime;                 // server time of the newest sample handed to the engine
+    EventTime flushedTime;             // ... and its event time
+};
+std::vector<MotionBatch> motionBatches; // raw motion queued since the last flush, per device
+std::vector<MotionSample> motionSamples; // the flushed batch, with event times
+
+void updateMonitorList();
+void updateBarriers();
+void flushMotion();
+void updateTick();
 
 std::string getDefaultConfigPath() {
     /*
@@ -135,121 +169,136 @@ std::string getDefaultConfigPath() {
     return cfgPath;
 }
 
-void loadConfig() {
-    if (cfgPath == "") {
-        cfgPath = getDefaultConfigPath();
-    }
-
-    std::cout << "Loading config " << cfgPath << std::endl;
-
-    // Remove old watch (to prevent 'infinite loop' of config reloading)
-    if (inotifyCfgW != -1)
-        inotify_rm_watch(inotifyFD, inotifyCfgW);
+/*
+Reads the config file into a new snapshot and checks it. Fails if it can't be read or has invalid
+values.
+*/
+bool readConfig(DaemonConfig *cfg) {
+    LOG_INFO("Loading config %s", cfgPath.c_str());
 
     try {
         config.open(cfgPath, false);
 
-        cfgEnabled = config.get("General", "Enabled", true);
-
-        cfgCornerSizeFactor = config.get("Screen", "CornerSizeFactor", 0.1f);
-        cfgResistanceMargins = config.get("Screen", "ResistanceMargins", 1);
-
-        cfgEdgePass.always = config.get("Edge Passthrough", "AllowAlways", false);
-        cfgEdgePass.baseDelay =
-            (duration<float>)config.get("Edge Passthrough", "BaseDelayOfSeconds", 0.4);
-        cfgEdgePass.maxDelay =
-            (duration<float>)config.get("Edge Passthrough", "MaxDelayOfSeconds", 0.6);
-        cfgEdgePass.minDelay =
-            (duration<float>)config.get("Edge Passthrough", "MinDelayOfSeconds", 0.0);
-        cfgEdgePass.returnBefore =
-            (duration<float>)config.get("Edge Passthrough", "FreelyReturnBeforeSeconds", 1);
-
-        cfgCornerPass.always = config.get("Corner Passthrough", "AllowAlways", false);
-        cfgCornerPass.baseDelay =
-            (duration<float>)config.get("Corner Passthrough", "BaseDelayOfSeconds", 0.7);
-        cfgCornerPass.maxDelay =
-            (duration<float>)config.get("Corner Passthrough", "MaxDelayOfSeconds", 1);
-        cfgCornerPass.minDelay =
-            (duration<float>)config.get("Corner Passthrough", "MinDelayOfSeconds", 0.0);
-        cfgCornerPass.returnBefore =
-            (duration<float>)config.get("Corner Passthrough", "FreelyReturnBeforeSeconds", 1);
-
-        cfgPtrInputsToRemember = config.get("Movement Calculation", "NoInputsToRemember", 50);
-        cfgPtrRememberForSeconds =
-            (duration<float>)config.get("Movement Calculation", "RememberForSeconds", 0.15);
-        cfgResistanceSlowdownExponent =
-            config.get("Movement Calculation", "ResistanceSlowdownExponent", 4.0);
-        cfgResistanceSpeedupExponent =
-            config.get("Movement Calculation", "ResistanceSpeedupExponent", 1.0);
-        cfgResistanceConstSpeedExponent =
-            config.get("Movement Calculation", "ResistanceConstantSpeedExponent", 0.1);
-        cfgResistanceDirectionExponent =
-            config.get("Movement Calculation", "ResistanceByDirectionExponent", 1.0);
-        cfgPassthroughSmoothingFactor =
-            config.get("Movement Calculation", "PassthroughSmoothingFactor", 0.05);
-    } catch (const MiIni<>::FileError &e) {
-        std::cerr << "Error while reading configuration: " << e.what() << '\n';
-    }
+        readEngineConfig(config, &cfg->engine);
+
+        cfg->useBarriers =
+            (config.get("Screen", "ConfinementBackend", std::string("grab")) == "barriers");
+        cfg->serverTimebase =
+            (config.get("Movement Calculation", "Timebase", std::string("server")) != "local");
 
-    config.sync();           // In case the config didn't exist before
-    cfgSavedByMyself = true; // Needed to skip the file change notification
+        cfg->reportRoundTrips = config.get("Pointer Tracking", "ReportRoundTrips", false);
+        cfg->coalesceMotion = config.get("Pointer Tracking", "CoalesceMotion", true);
+        cfg->pauseRawMotion = config.get("Pointer Tracking", "PauseRawMotionFarFromEdges", false);
 
-    // Add config modification watch
-    if (inotifyFD != -1) {
-        inotifyCfgW = inotify_add_watch(inotifyFD, cfgPath.c_str(), IN_CLOSE_WRITE);
+        cfg->statsEnabled = config.get("Statistics", "Enabled", false);
 
-        if (inotifyCfgW == -1)
-            std::cerr << "Error in inotify_add_watch(). Config '" << cfgPath
-                      << "' will not be auto-reloaded when changed." << std::endl;
+        cfg->threaded = config.get("General", "Threaded", false);
+        std::string logLevel = config.get("General", "LogLevel", std::string("info"));
+        if (!parseLogLevel(logLevel, &cfg->logLevel)) {
+            LOG_ERROR("Unknown LogLevel '%s'. Use debug, info, warning, error or off.",
+                      logLevel.c_str());
+            return false;
+        }
+    } catch (const MiIni<>::FileError &e) {
+        LOG_ERROR("Error while reading configuration: %s", e.what());
+        return false;
+    }
+
+    std::string error;
+    if (!validateEngineConfig(cfg->engine, &error)) {
+        LOG_ERROR("Invalid configuration: %s", error.c_str());
+        return false;
     }
+    return true;
 }
 
-Window createMonitorSpanWindow(int x, int y, unsigned int w, unsigned int h) {
-    XSetWindowAttributes atr;
-    atr.override_redirect = true;
-    Window wnd = XCreateWindow(display, rootWindow, x, y, w, h,
-                               0,                  // border width
-                               0,                  // depth
-                               InputOnly,          // class (input-only)
-                               0,                  // visual
-                               CWOverrideRedirect, // valuemask
-                               &atr                // attributes
-    );
+/*
+Watches the config's directory for the file being written or replaced. Done once; the watch
+stays across reloads.
+*/
+void watchConfig() {
+    if (inotifyFD == -1)
+        return;
+
+    size_t slash = cfgPath.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : cfgPath.substr(0, slash + 1);
+    cfgFileName = (slash == std::string::npos) ? cfgPath : cfgPath.substr(slash + 1);
 
-    /*In case the window manager still interferes, make the window fullscreen*/
-    Atom wm_state = XInternAtom(display, "_NET_WM_STATE", true);
-    Atom wm_fullscreen = XInternAtom(display, "_NET_WM_STATE_FULLSCREEN", true);
-    XChangeProperty(display, wnd, wm_state, XA_ATOM, 32, PropModeReplace,
-                    (unsigned char *)&wm_fullscreen, 1);
+    inotifyCfgW = inotify_add_watch(inotifyFD, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (inotifyCfgW == -1)
+        LOG_WARNING("Error in inotify_add_watch(). Config '%s' will not be auto-reloaded when "
+                    "changed.",
+                    cfgPath.c_str());
+}
 
-    /* Keep the window on the bottom so it's not visible or interactible when shown*/
-    XLowerWindow(display, wnd);
+/*
+Configures the engine with the settings in effect: the config's, with the rule of the focused
+window over them.
+*/
+void configureEngine() {
+    int rule = activeWindow.rule();
+    if (rule == -1)
+        engine.configure(activeCfg->engine);
+    else
+        engine.configure(withAppRule(activeCfg->engine, activeCfg->engine.appRules[rule]));
+}
 
-    /*In case this doesn't work due to the window manager, tell the WM to treat the window as a
-     * desktop surface. This shouldn't be an issue since this window won't be shown most of the
-     * time*/
-    Atom wm_window_type = XInternAtom(display, "_NET_WM_WINDOW_TYPE", False);
-    Atom wm_desktop = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
-    XChangeProperty(display, wnd, wm_window_type, XA_ATOM, 32, PropModeReplace,
-                    (unsigned char *)&wm_desktop, 1);
+/*
+Puts the latest config snapshot into effect, if there is a new one. Runs on the decision thread in
+threaded mode.
+*/
+void applyConfig() {
+    // The previous snapshot may be freed once the new one is taken
+    const DaemonConfig *prev = activeCfg;
+    bool prevServerTimebase = prev && prev->serverTimebase;
+
+    const DaemonConfig *cfg = configs.current();
+    if (cfg == prev)
+        return;
+    activeCfg = cfg;
+
+    if (!prev || cfg->serverTimebase != prevServerTimebase) {
+        // Times from different sources can't be compared
+        serverTime.reset();
+        engine.forgetMovement();
+    }
+    asyncLog.minLevel = cfg->logLevel;
+
+    activeWindow.setRules(&cfg->engine.appRules);
+    configureEngine();
+    engine.stats().enabled = cfg->statsEnabled;
+    if (cfg->statsEnabled && !statsFile.isOpen()) {
+        std::string statsPath = defaultStatsPath();
+        if (statsPath == "")
+            LOG_WARNING("XDG_RUNTIME_DIR isn't set, not publishing statistics");
+        else if (statsFile.open(statsPath, &engine.stats()))
+            LOG_INFO("Publishing statistics to %s", statsPath.c_str());
+        else
+            LOG_WARNING("Cannot create statistics file '%s'", statsPath.c_str());
+    }
+    statsFile.setEnabled(cfg->statsEnabled);
+    inputThread.timestamps = engine.stats().active();
+    backend.useBarriers = cfg->useBarriers;
 
-    return wnd;
+    // Apply the screen settings if we are already running
+    if (display)
+        updateMonitorList();
 }
 
+/*
+Asks the server for the deepest window under the pointer, one level at a time.
+Only used when the window cache can't be trusted.
+*/
 Window getWindowAt(Window parent, int x, int y) {
-    unsigned int nchildren;
-    Window retroot, retparent, *children;
     Window child;
-    XWindowAttributes wndAtr;
-
     Window parentDummy;
     int root_x, root_y, win_x, win_y;
     unsigned int maskDummy;
+    backend.roundTrips++;
     bool ret = XQueryPointer(display, parent, &parentDummy, &child, &root_x, &root_y, &win_x,
                              &win_y, &maskDummy);
 
     if (ret) {
-        printf("Child %x; ", (int)child);
         if (child == 0 || child == parent) {
             return parent;
         }
@@ -263,299 +312,640 @@ Window getWindowAt(Window parent, int x, int y) {
     return 0;
 }
 
-Monitor *getMonitorAt(int x, int y) {
-    Monitor *monitor = nullptr;
-    for (auto &m : monitors) {
-        if (m.contains(x, y)) {
-            monitor = &m;
-        }
-    }
-    return monitor;
-}
-
+/*
+Reads the monitors from the server and hands them to the engine. The confining window may move
+or disappear, so the pointer is released first.
+*/
 void updateMonitorList() {
-    XRRScreenResources *res = XRRGetScreenResourcesCurrent(display, rootWindow);
-
-    for (Monitor &mon : monitors) {
-        XDestroyWindow(display, mon.inputWindow);
-    }
-    monitors.clear();
-
-    // CRTC seems to be a monitor assigned to a rectangle of this Screen
-    for (int j = 0; j < res->ncrtc; j++) {
-        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(display, res, res->crtcs[j]);
-        if (crtc_info->noutput) {
-            monitors.push_back(
-                Monitor{crtc_info->x, crtc_info->y, crtc_info->width, crtc_info->height,
-                        createMonitorSpanWindow(crtc_info->x + cfgResistanceMargins,
-                                                crtc_info->y + cfgResistanceMargins,
-                                                crtc_info->width - cfgResistanceMargins * 2,
-                                                crtc_info->height - cfgResistanceMargins * 2)});
-            printf("Found monitor:%3i x:%5i y:%5i w:%4i h:%4i, Window %x\n", j, crtc_info->x,
-                   crtc_info->y, crtc_info->width, crtc_info->height,
-                   (int)monitors.back().inputWindow);
-        }
-        XFree(crtc_info);
-    }
-    XFree(res);
+    engine.unconfineAll();
 
-    // Reset pointer position info
-    Window childDummy, parentDummy;
-    int root_x, root_y, win_x, win_y;
-    unsigned int maskDummy;
-    XQueryPointer(display, rootWindow, &rootWindow, &childDummy, &root_x, &root_y, &win_x, &win_y,
-                  &maskDummy);
+    std::vector<Monitor> monitors;
+    backend.updateMonitors(activeCfg->engine.resistanceMargins, &monitors);
+    engine.setMonitors(monitors);
 
-    ptrMemory.clear();
-    for (int i = 0; i < cfgPtrInputsToRemember; i++)
-        ptrMemory.emplace_back(root_x, root_y, 0, 0, 0);
+    // The positions of absolute devices span the screen, which may have been resized
+    if (!threadedMode)
+        pointerDevices.update(display, rootWindow, &backend.roundTrips);
 
-    // Find the monitor on which we are rn
-    currentMonitor = getMonitorAt(root_x, root_y);
-    brokeFromMonitor = nullptr;
-    onEdge = false;
+    int x, y;
+    engine.pointerPosition(backend.clientPointer(), &x, &y);
+    trace.layout(engine.monitors(), x, y);
+    updateBarriers();
 }
 
-void movePointer(int x, int y) {
-    XWarpPointer(display, None, rootWindow, 0, 0, 0, 0, x, y);
-    XFlush(display);
+// Puts barriers on the shared edges while the engine is enabled, if they are used
+void updateBarriers() {
+    if (engine.config().enabled)
+        backend.createBarriers(engine.layout(), engine.monitors());
+    else
+        backend.destroyBarriers();
+    engine.decideOnBarrierHits(backend.usingBarriers());
 }
 
-Window pointerConfined = 0;
-void confinePointer(const Monitor *mon) {
-    if (pointerConfined == 0) {
-
-        // show the (invisible) window so it can grab the pointer
-        XMapWindow(display, mon->inputWindow);
+/*
+Switches to the settings of the rule matching the newly focused window.
+*/
+void applyAppRule() {
+    bool wasEnabled = engine.config().enabled;
+    configureEngine();
+    if (engine.config().enabled != wasEnabled)
+        updateBarriers();
+
+    int rule = activeWindow.rule();
+    LOG_DEBUG("App rule: %s", rule == -1 ? "none" : activeCfg->engine.appRules[rule].name.c_str());
+}
 
-        // use the window server to forcefully keep the pointer in the screen,
-        // to prevent flicker
-        XGrabPointer(display, mon->inputWindow, false,
-                     ButtonPressMask | ButtonReleaseMask | PointerMotionMask, GrabModeAsync,
-                     GrabModeAsync, mon->inputWindow, None, lastPtrMoveX11Time);
+/*
+Selects the XInput events we listen to on the root window. In threaded mode the input thread reads
+the raw motion on its own connection, and follows the changes to the devices that affect it.
+*/
+void selectXIEvents() {
+    XIEventMask masks[2];
+    unsigned char mask[(XI_LASTEVENT + 7) / 8];
+    unsigned char deviceMask[(XI_LASTEVENT + 7) / 8];
 
-        pointerConfined = mon->inputWindow;
-        printf("Confined pointer to x:%5i y:%5i w:%4i h:%4i, Window %x\n", mon->x, mon->y, mon->w,
-               mon->h, (int)mon->inputWindow);
+    memset(mask, 0, sizeof(mask));
+    memset(deviceMask, 0, sizeof(deviceMask));
+    if (!threadedMode && !rawMotionPaused)
+        XISetMask(mask, XI_RawMotion);
+    if (backend.barriersSupported)
+        XISetMask(mask, XI_BarrierHit);
+    if (!threadedMode) {
+        XISetMask(deviceMask, XI_HierarchyChanged);
+        XISetMask(deviceMask, XI_DeviceChanged);
     }
 
-    // warp the pointer back into the screen just in case
-    Window childWnd;
-    int x, y, win_x, win_y;
-    unsigned int maskDummy;
-    XQueryPointer(display, rootWindow, &rootWindow, &childWnd, &x, &y, &win_x, &win_y, &maskDummy);
-    currentMonitor->snapPosition(&x, &y);
-    movePointer(x, y);
+    masks[0].deviceid = XIAllMasterDevices;
+    masks[0].mask_len = sizeof(mask);
+    masks[0].mask = mask;
+    masks[1].deviceid = XIAllDevices;
+    masks[1].mask_len = sizeof(deviceMask);
+    masks[1].mask = deviceMask;
 
+    XISelectEvents(display, rootWindow, masks, 2);
     XFlush(display);
 }
-void unconfinePointer() {
-    if (pointerConfined != 0) {
-        XUngrabPointer(display, lastPtrMoveX11Time);
-        XUnmapWindow(display, pointerConfined);
-        XAllowEvents(display, ReplayPointer, lastPtrMoveX11Time);
-        XFlush(display);
-        pointerConfined = 0;
-        std::cout << "Unconfined pointer" << std::endl;
-    }
+
+/*
+Stops listening to raw motion while no pointer is near a shared edge, if asked to, and starts again
+once one is. Only with barriers, whose hits tell when a pointer got to an edge anyway, and not in
+threaded mode, where the input thread reads the motion.
+*/
+void updateRawMotion() {
+    bool pause = activeCfg->pauseRawMotion && !threadedMode && backend.usingBarriers() &&
+                 engine.idle();
+    if (pause == rawMotionPaused)
+        return;
+    rawMotionPaused = pause;
+    selectXIEvents();
+    if (pause)
+        engine.stats().count(StatRawMotionPauses);
+    LOG_DEBUG("Raw motion %s", pause ? "paused, far from the edges" : "resumed");
+}
+
+/*
+Prints how many synchronous requests we made per second since the last report, if enabled.
+Called from the periodic timer.
+*/
+void reportRoundTrips() {
+    auto now = high_resolution_clock::now();
+    duration<float> elapsed = now - lastRoundTripReport;
+    if (activeCfg->reportRoundTrips && elapsed.count() > 0.0f)
+        LOG_INFO("X round-trips per second: %.1f", backend.roundTrips / elapsed.count());
+    engine.stats().count(StatRoundTrips, backend.roundTrips);
+    backend.roundTrips = 0;
+    lastRoundTripReport = now;
 }
 
-float ptrSpeed1 = 0.0f, ptrSpeed2 = 0.0f;
-void pointerSpeedChanged(Time time, int x, int y, double dx, double dy) {
-    // store time
-    lastPtrMoveX11Time = time;
+/*
+Prints the statistics, on SIGUSR1.
+*/
+void dumpStats() {
+    // Take the round-trips counted since the last report
+    engine.stats().count(StatRoundTrips, backend.roundTrips);
+    backend.roundTrips = 0;
+
+    if (!engine.stats().active())
+        printf("Statistics are disabled. Set Enabled=true in the [Statistics] section.\n");
+    engine.stats().dump(stdout);
+}
 
-    // Remember the state
-    PtrEntry &prev = ptrMemory[ptrMemory.size() - 1]; // previous pointer state
-    PtrEntry current(x, y, 0.0f, dx, dy);             // current pointer state
-    duration<float> secondsElapsed = current.moveTimepoint - prev.moveTimepoint;
+void wakeDecisions() {
+    uint64_t one = 1;
+    if (write(wakeFD, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+        LOG_ERROR("Cannot wake the decision thread");
+}
+
+/*
+Reads the config and publishes it, to be put into effect by the decision thread in threaded
+mode. An invalid config is rejected and the previous one kept.
+*/
+void loadConfig() {
+    std::unique_ptr<DaemonConfig> cfg(new DaemonConfig());
+    if (!readConfig(cfg.get())) {
+        if (loadedCfg) {
+            LOG_WARNING("Keeping the previous configuration");
+            return;
+        }
+        LOG_WARNING("Using the default configuration");
+        cfg.reset(new DaemonConfig());
+    }
+    if (loadedCfg && cfg->threaded != threadedMode)
+        LOG_WARNING("Threaded mode is only switched when the program starts");
+
+    loadedCfg = configs.publish(std::move(cfg));
+    if (threadedMode)
+        wakeDecisions();
+    else
+        applyConfig();
+    updateTick();
+}
 
-    // calc speed
-    float dis = std::sqrt(dx * dx + dy * dy);
-    if (secondsElapsed.count() != 0) {
-        current.speed = dis;
-        // dis / secondsElapsed.count();
+// Asks the decision thread to run the periodic work or to dump the statistics, in threaded mode
+void postRequest(bool Mailbox::*request) {
+    {
+        std::lock_guard<std::mutex> lock(mailbox.mutex);
+        mailbox.*request = true;
     }
-    ptrMemory.pop_front();        // remove old pointer data
-    ptrMemory.push_back(current); // add new pointer data
+    wakeDecisions();
+}
 
-    // Calc 2 average speeds to determine if we are accelerating or slowing
-    // down, and use the difference in further calcs
-    ptrSpeed1 = 0.0f;
-    ptrSpeed2 = 0.0f;
+// Carries out the control thread's requests, on the decision thread
+void handleMailbox() {
+    bool dump, tick;
+    {
+        std::lock_guard<std::mutex> lock(mailbox.mutex);
+        dump = mailbox.dumpStats;
+        tick = mailbox.tick;
+        mailbox.dumpStats = mailbox.tick = false;
+    }
+    if (tick)
+        reportRoundTrips();
+    if (dump)
+        dumpStats();
+}
 
-    for (int i = 0; i < ptrMemory.size() - 1; i++) {
-        auto timeDiff = current.moveTimepoint - ptrMemory[i].moveTimepoint;
+/*
+Event loop variables
+*/
+int epollFD;
+int signalFD;     // SIGHUP reloads the config, SIGUSR1 dumps the stats, SIGTERM and SIGINT stop
+int timerFD = -1; // periodic tick for housekeeping, armed only while there's some
+bool tickArmed;   // ... and whether it is
+int passTimerFD;  // fires when the deadline requested by the engine expires
+int decisionEpollFD; // the decision thread's event sources, in threaded mode
+std::atomic<bool> running;
 
-        if (timeDiff <= cfgPtrRememberForSeconds) {
-            ptrSpeed1 = ptrMemory[i].speed;
+/*
+EVENT handlers
+*/
+/*
+Queues a raw motion event, to be processed together with the other motion of the same device
+that arrived in the same batch.
+*/
+void queueMotion(int deviceid, Time time, double dx, double dy, bool absolute,
+                 Stats::Clock::time_point received) {
+    MotionBatch *batch = nullptr;
+    for (auto &b : motionBatches) {
+        if (b.deviceid == deviceid) {
+            batch = &b;
             break;
         }
     }
-    ptrSpeed2 = current.speed;
-
-    // printf("Current: %9.2f, first: %9.2f, second: %9.2f, Res: %4.2f\n", dis,
-    // ptrSpeed1, ptrSpeed2, resistanceFactor);
+    if (!batch) {
+        motionBatches.push_back(MotionBatch{deviceid, absolute, {}, {}, CurrentTime, EventTime()});
+        batch = &motionBatches.back();
+    }
+    // A batch comes from either kind of device
+    if (batch->absolute != absolute && !batch->samples.empty())
+        flushMotion();
+    if (batch->samples.empty()) {
+        batch->absolute = absolute;
+        batch->received = received;
+    }
+    batch->samples.push_back(QueuedMotion{time, dx, dy});
+    engine.stats().count(StatRawEvents);
 }
 
-void pointerPositionChanged(Time time, int x, int y) {
+/*
+Hands the queued motion to the engine, one batch per device, with the X timestamps turned into
+event times.
+*/
+void flushMotion() {
+    // Only read the clock if the local timebase needs it
+    EventTime now = activeCfg->serverTimebase ? EventTime() : EventClock::fromLocalClock();
+
+    for (auto &batch : motionBatches) {
+        if (batch.samples.empty())
+            continue;
+
+        // Local times are spaced like the server times, ending at the time we received them.
+        // The trace holds a single pointer, ours
+        const Time lastTime = batch.samples.back().time;
+        const bool traced = trace.isOpen() && batch.deviceid == backend.clientPointer();
+        motionSamples.clear();
+        for (const auto &sample : batch.samples) {
+            EventTime timepoint = activeCfg->serverTimebase
+                                      ? serverTime.extend(sample.time)
+                                      : now - milliseconds((uint32_t)(lastTime - sample.time));
+            motionSamples.push_back(MotionSample{timepoint, sample.dx, sample.dy});
+            if (traced)
+                trace.motion(timepoint, sample.dx, sample.dy,
+                             motionSamples.size() == batch.samples.size());
+        }
 
-    // Do nothing if we are outside any monitor
-    if (currentMonitor) {
-        const auto &current = ptrMemory.back();
+        backend.lastEventTime = lastTime;
+        batch.flushedXTime = lastTime;
+        batch.flushedTime = motionSamples.back().time;
+        engine.motion(batch.deviceid, motionSamples.data(), (int)motionSamples.size(),
+                      batch.absolute);
+        if (batch.received != Stats::Clock::time_point())
+            engine.stats().record(StageLatency, batch.received);
+        engine.stats().count(StatMotionBatches);
+        engine.stats().count(StatCoalesced, batch.samples.size() - 1);
+        batch.samples.clear();
+    }
+}
 
-        // If the pointer tries to exit the monitor
-        if (!currentMonitor->contains(x, y, cfgResistanceMargins)) {
-            Monitor *newMonitor =
-                getMonitorAt(x + cfgResistanceMargins *
-                                     ((x > currentMonitor->x + currentMonitor->w / 2) ? 1 : -1),
-                             y + cfgResistanceMargins *
-                                     ((y > currentMonitor->y + currentMonitor->h / 2) ? 1 : -1));
-            PassConfig *passCfg;
-            bool pass;
+/*
+The event time of a barrier hit. A hit with the same server time as the newest raw motion of its
+pointer gets the same event time, so the engine knows it already has that motion.
+*/
+EventTime barrierHitTime(const XIBarrierEvent *ev) {
+    for (const MotionBatch &batch : motionBatches)
+        if (batch.deviceid == ev->deviceid && batch.flushedXTime == ev->time)
+            return batch.flushedTime;
+    return activeCfg->serverTimebase ? serverTime.extend(ev->time) : EventClock::fromLocalClock();
+}
 
-            // Find on which corner/edge we are rn
-            bool onHorCorner =
-                (x < currentMonitor->x + currentMonitor->w * cfgCornerSizeFactor) ||
-                (x > currentMonitor->x + currentMonitor->w * (1.0f - cfgCornerSizeFactor));
-            bool onVerCorner =
-                (y < currentMonitor->y + currentMonitor->h * cfgCornerSizeFactor) ||
-                (y > currentMonitor->y + currentMonitor->h * (1.0f - cfgCornerSizeFactor));
-            bool onVerEdge = (y >= currentMonitor->y && y < currentMonitor->y + currentMonitor->h);
-            bool onHorEdge = (x >= currentMonitor->x && x < currentMonitor->x + currentMonitor->w);
+/*
+Lists the devices again when one was added, removed or changed, but not when the pointer only
+switched to another of them.
+*/
+void handleDeviceChange(XEvent &xevent) {
+    if (!XGetEventData(display, &xevent.xcookie))
+        return;
+    XGenericEventCookie *cookie = &xevent.xcookie;
+    if (cookie->evtype == XI_HierarchyChanged ||
+        ((XIDeviceChangedEvent *)cookie->data)->reason == XIDeviceChange) {
+        flushMotion();
+        pointerDevices.update(display, rootWindow, &backend.roundTrips);
+    }
+    XFreeEventData(display, cookie);
+}
 
-            if (onHorCorner && onVerCorner)
-                passCfg = &cfgCornerPass;
-            else
-                passCfg = &cfgEdgePass;
-
-            // Should we ignore the resistance altogether?
-            if (passCfg->always ||
-                (newMonitor == brokeFromMonitor &&
-                 (current.moveTimepoint - brokeFromTimepoint) < passCfg->returnBefore)) {
-                pass = true;
-            } else {
-                // keep track of the time if we collided with the edge right now
-                if (!onEdge || passCfg != lastPassCfg) {
-                    onEdge = true;
-                    touchedEdgeTime = current.moveTimepoint;
-                }
+void handleXEvent(XEvent &xevent) {
+    StageTimer timer(engine.stats(), StageDispatch);
 
-                // Calc resistance factor for making it harder to pass
-                float resistanceFactor;
-                if (ptrSpeed1 > 0 && ptrSpeed2 > 0) {
-                    // If we are slowing down, resistance must be higher (prolly
-                    // trying to hit a button)
-                    resistanceFactor = ptrSpeed1 / ptrSpeed2;
-
-                    if (ptrSpeed1 > ptrSpeed2)
-                        resistanceFactor =
-                            std::pow(resistanceFactor, cfgResistanceSlowdownExponent);
-                    else
-                        resistanceFactor = std::pow(resistanceFactor, cfgResistanceSpeedupExponent);
-
-                    resistanceFactor *=
-                        std::pow(std::abs(ptrSpeed1 - ptrSpeed2) / std::max(ptrSpeed1, ptrSpeed2),
-                                 cfgResistanceConstSpeedExponent);
-
-                    if (onVerEdge && current.dx != 0.0)
-                        resistanceFactor *= std::pow(ptrSpeed2 / std::abs(current.dx),
-                                                     cfgResistanceDirectionExponent);
-                    else if (onHorEdge && current.dy != 0.0)
-                        resistanceFactor *= std::pow(ptrSpeed2 / std::abs(current.dy),
-                                                     cfgResistanceDirectionExponent);
-                } else {
-                    resistanceFactor = 1;
-                }
-                resistanceFactor = (resistanceFactor - cfgPassthroughSmoothingFactor) /
-                                   (1.0 - cfgPassthroughSmoothingFactor);
-
-                // adjust the base delay by the factor
-                auto adjustedDelay =
-                    (std::max(std::min(passCfg->baseDelay * resistanceFactor, passCfg->maxDelay),
-                              passCfg->minDelay));
-
-                // check how long have we been pushing through the edge and
-                // passthrough if it's longer than the expected delay
-                if ((current.moveTimepoint - touchedEdgeTime) > adjustedDelay) {
-                    pass = true;
-                } else {
-                    pass = false;
+    switch (xevent.type) {
+    case GenericEvent:
+        // Devices were added or changed, which may change how to read their raw motion
+        if (xevent.xcookie.extension == xiExtOpcode &&
+            (xevent.xcookie.evtype == XI_HierarchyChanged ||
+             xevent.xcookie.evtype == XI_DeviceChanged)) {
+            handleDeviceChange(xevent);
+            break;
+        }
+
+        // Skip this completely if sticky edges aren't enabled
+        if (engine.config().enabled && XGetEventData(display, &xevent.xcookie)) {
+            XGenericEventCookie *cookie = &xevent.xcookie;
+
+            // Keep the order of events; motion queued before other events must be handled first
+            if (cookie->extension != xiExtOpcode || cookie->evtype != XI_RawMotion)
+                flushMotion();
+
+            if (cookie->extension == xiExtOpcode && cookie->evtype == XI_BarrierHit) {
+                XIBarrierEvent *barrierEvent = (XIBarrierEvent *)cookie->data;
+
+                // Already let through
+                if (!(barrierEvent->flags & XIBarrierPointerReleased)) {
+                    backend.barrierHit(barrierEvent);
+                    engine.barrierHit(barrierEvent->deviceid, barrierHitTime(barrierEvent),
+                                      barrierEvent->root_x, barrierEvent->root_y, barrierEvent->dx,
+                                      barrierEvent->dy);
                 }
+            } else if (cookie->extension == xiExtOpcode && cookie->evtype == XI_RawMotion) {
+                // This is the event we were looking for
+                XIRawEvent *motionEvent = (XIRawEvent *)cookie->data;
+
+                double dx, dy;
+                bool absolute = pointerDevices.rawDeltas(motionEvent, &dx, &dy);
+                queueMotion(motionEvent->deviceid, motionEvent->time, dx, dy, absolute,
+                            engine.stats().start());
+                if (!activeCfg->coalesceMotion)
+                    flushMotion();
             }
-            lastPassCfg = passCfg;
-
-            if (pass) {
-                onEdge = false;
-                brokeFromTimepoint = current.moveTimepoint;
-                brokeFromMonitor = currentMonitor;
-                currentMonitor = newMonitor;
-            } else {
-                /*
-                Manually setting the position causes the pointer to 'flicker'
-                because of the delay between the movePointer() call and actual
-                pointer update on screen. We confine the pointer in window
-                spanning the whole monitor.
-                */
-                confinePointer(currentMonitor);
-            }
-        } else {
-            if (currentMonitor->contains(x + current.dx, y + current.dy, cfgResistanceMargins)) {
-                unconfinePointer();
-            }
-            if (currentMonitor->contains(x, y, cfgResistanceMargins + 1)) {
-                onEdge = false;
-            }
+            XFreeEventData(display, cookie);
+        }
+        break;
+    // Core events come from the grab, which holds our client pointer
+    case MotionNotify:
+        flushMotion();
+        backend.lastEventTime = xevent.xmotion.time;
+        engine.pointerAt(backend.clientPointer(), xevent.xmotion.x_root, xevent.xmotion.y_root);
+        break;
+    case ButtonPress:
+    case ButtonRelease: {
+        flushMotion();
+        backend.lastEventTime = xevent.xbutton.time;
+        if (trace.isOpen()) {
+            EventTime timepoint = activeCfg->serverTimebase ? serverTime.extend(xevent.xbutton.time)
+                                                    : EventClock::fromLocalClock();
+            trace.button(timepoint, xevent.xbutton.button, xevent.type == ButtonPress,
+                         xevent.xbutton.x_root, xevent.xbutton.y_root);
+        }
+
+        // free the pointer
+        engine.unconfine(backend.clientPointer());
+
+        // replay the event to the window under sursor
+        if (const Monitor *mon =
+                engine.getMonitor(engine.currentMonitor(backend.clientPointer())))
+            mon->snapPosition(&xevent.xbutton.x_root, &xevent.xbutton.y_root,
+                              activeCfg->engine.resistanceMargins);
+        Window cursorWindow;
+        if (!windowCache.windowAt(xevent.xbutton.x_root, xevent.xbutton.y_root, &cursorWindow,
+                                  &xevent.xbutton.x, &xevent.xbutton.y)) {
+            // Ask the server. The cache is rebuilt for the next time once the click went out
+            cursorWindow = getWindowAt(rootWindow, xevent.xbutton.x_root, xevent.xbutton.y_root);
+            Window childDummy;
+            backend.roundTrips++;
+            XTranslateCoordinates(display, rootWindow, cursorWindow, xevent.xbutton.x_root,
+                                  xevent.xbutton.y_root, &xevent.xbutton.x, &xevent.xbutton.y,
+                                  &childDummy);
+            windowCacheMissed = true;
+        }
+        xevent.xbutton.window = cursorWindow;
+        XSendEvent(display, cursorWindow, True, ButtonPressMask | ButtonReleaseMask, &xevent);
+        XFlush(display);
+
+        // notify of the change
+        engine.pointerAt(backend.clientPointer(), xevent.xbutton.x_root, xevent.xbutton.y_root);
+        break;
+    }
+    case PropertyNotify:
+        if (activeWindow.handleEvent(xevent))
+            applyAppRule();
+        break;
+    case CreateNotify:
+    case DestroyNotify:
+    case ConfigureNotify:
+    case GravityNotify:
+    case MapNotify:
+    case UnmapNotify:
+    case ReparentNotify:
+    case CirculateNotify:
+        windowCache.handleEvent(xevent);
+        break;
+    default:
+        // Apply the changes once the whole burst of notifications is in
+        if (xevent.type == xrrEventBase + RRScreenChangeNotify ||
+            xevent.type == xrrEventBase + RRNotify) {
+            XRRUpdateConfiguration(&xevent);
+            monitorsChanged = true;
+        }
+        break;
+    }
+}
+
+/*
+Handles all X events that arrived, in one batch. Motion is coalesced until the queue is empty.
+*/
+void handleXEvents() {
+    XEvent xevent;
+    while (running && XPending(display)) {
+        XNextEvent(display, &xevent);
+        handleXEvent(xevent);
+    }
+    flushMotion();
+
+    if (monitorsChanged) {
+        monitorsChanged = false;
+        updateMonitorList();
+    }
+    if (windowCacheMissed) {
+        windowCacheMissed = false;
+        windowCache.init(display, rootWindow, &eventMasks);
+    }
+    updateRawMotion();
+}
+
+/*
+Queues the raw motion the input thread read, in threaded mode. It comes in on another connection,
+so it's only ordered approximately with the events of the main one: all of it is handled first.
+*/
+void takeInputSamples() {
+    InputSample sample;
+    while (inputThread.pop(&sample)) {
+        queueMotion(sample.deviceid, sample.time, sample.dx, sample.dy, sample.absolute,
+                    sample.received);
+        if (!activeCfg->coalesceMotion)
+            flushMotion();
+    }
+
+    unsigned long dropped = inputThread.takeDropped();
+    if (dropped > 0) {
+        engine.stats().count(StatDroppedSamples, dropped);
+        LOG_WARNING("Dropped %lu raw motion events, the decision thread fell behind", dropped);
+    }
+}
+
+void handleInotify() {
+    const int inotifyBufSize = sizeof(inotify_event) + PATH_MAX + 1;
+    alignas(inotify_event) char inotifyBuf[inotifyBufSize];
+    bool cfgChanged = false;
+
+    int numRead;
+    while ((numRead = read(inotifyFD, inotifyBuf, inotifyBufSize)) > 0) {
+        int pos = 0;
+        while (pos < numRead) {
+            inotify_event *ev = (inotify_event *)(inotifyBuf + pos);
+            if (ev->wd == inotifyCfgW && ev->len > 0 && cfgFileName == ev->name)
+                cfgChanged = true;
+            pos += sizeof(inotify_event) + ev->len;
         }
-    } else {
-        currentMonitor = getMonitorAt(x, y);
+    }
+
+    if (cfgChanged) {
+        LOG_INFO("Config file changed...");
+        loadConfig();
+    }
+}
+
+void handleSignals() {
+    signalfd_siginfo info;
+    while (read(signalFD, &info, sizeof(info)) == sizeof(info)) {
+        switch (info.ssi_signo) {
+        case SIGHUP:
+            // After first load, only used on SIGHUP signal or file change
+            LOG_INFO("Received signal for reloading config...");
+            loadConfig();
+            break;
+        case SIGUSR1:
+            if (threadedMode)
+                postRequest(&Mailbox::dumpStats);
+            else
+                dumpStats();
+            break;
+        case SIGTERM:
+        case SIGINT:
+            running = false;
+            if (threadedMode)
+                wakeDecisions();
+            break;
+        }
+    }
+}
+
+void handlePassTimer() {
+    uint64_t expirations;
+    if (read(passTimerFD, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+    DeviceId device;
+    while (backend.takeExpiredDeadline(&device))
+        engine.deadlineExpired(device);
+}
+
+/*
+Arms the periodic tick while there's work for it: reporting the round-trips, or adding them to the
+published statistics. Otherwise an idle program, and its decision thread, would wake for nothing.
+*/
+void updateTick() {
+    bool wanted = loadedCfg->reportRoundTrips || loadedCfg->statsEnabled;
+    if (timerFD == -1 || wanted == tickArmed)
+        return;
+    itimerspec tick = {};
+    if (wanted) {
+        tick.it_interval.tv_sec = 1;
+        tick.it_value.tv_sec = 1;
+    }
+    timerfd_settime(timerFD, 0, &tick, nullptr);
+    tickArmed = wanted;
+}
+
+void handleTimer() {
+    uint64_t expirations;
+    if (read(timerFD, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+    if (threadedMode)
+        postRequest(&Mailbox::tick);
+    else
+        reportRoundTrips();
+}
+
+void watchFD(int epoll, int fd) {
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev) == -1)
+        LOG_ERROR("Error in epoll_ctl() for fd %i", fd);
+}
+
+void handleWake() {
+    // Only resets the counter; the samples and requests are taken after every wakeup anyway
+    uint64_t count;
+    while (read(wakeFD, &count, sizeof(count)) == sizeof(count)) {
     }
 }
 
 /*
-SIGNAL HANDLERS
+The decision thread of the threaded mode. Everything that touches the engine or the main
+connection happens here.
 */
-bool reloadCfg;
-bool running;
-void reloadCfgSignal(int) { reloadCfg = true; }
-void terminateSignal(int) { running = false; }
+void runDecisions() {
+    const int maxEpollEvents = 4;
+    epoll_event epollEvents[maxEpollEvents];
+    while (running) {
+        XFlush(display);
+        int timeout = XEventsQueued(display, QueuedAlready) > 0 ? 0 : -1;
+
+        int numEvents = epoll_wait(decisionEpollFD, epollEvents, maxEpollEvents, timeout);
+        if (numEvents == -1 && errno != EINTR) {
+            LOG_ERROR("Error in epoll_wait() in the decision thread. Exiting...");
+            kill(getpid(), SIGTERM); // to stop the control thread
+            break;
+        }
+
+        for (int i = 0; i < numEvents; i++) {
+            int fd = epollEvents[i].data.fd;
+            if (fd == passTimerFD)
+                handlePassTimer();
+            else if (fd == wakeFD)
+                handleWake();
+        }
+
+        applyConfig();
+        handleMailbox();
+        takeInputSamples();
+        handleXEvents();
+    }
+}
 
 /*
 ERROR handlers
 */
 int handleXError(Display *d, XErrorEvent *e) {
     char errMsgBuffer[1000];
-    XGetErrorText(display, e->error_code, errMsgBuffer, sizeof(errMsgBuffer));
-    std::cerr << "Error code: " << e->error_code << ", detail: " << errMsgBuffer << std::endl;
+    XGetErrorText(d, e->error_code, errMsgBuffer, sizeof(errMsgBuffer));
+    LOG_ERROR("Error code: %i, detail: %s", e->error_code, errMsgBuffer);
     return 0;
 }
 
 int main(int argc, char **argv) {
     // ---Read arguments---
-    if (argc >= 2)
-        cfgPath = argv[1];
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else
+            cfgPath = argv[i];
+    }
+
+    // ---Signals---
+    // Blocked signals are only delivered through the signalfd, so nothing is lost between waits.
+    // Blocked before starting any thread, which would otherwise receive them
+    sigset_t sigMask;
+    sigemptyset(&sigMask);
+    sigaddset(&sigMask, SIGHUP);
+    sigaddset(&sigMask, SIGUSR1);
+    sigaddset(&sigMask, SIGTERM);
+    sigaddset(&sigMask, SIGINT);
+    sigprocmask(SIG_BLOCK, &sigMask, nullptr);
+
+    // ---Start logging---
+    asyncLog.start();
 
     // ---Prepare inotify---
-    inotifyFD = inotify_init();
+    inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (inotifyFD == -1)
-        std::cerr << "Error in inotify_init(). Config will not be "
-                     "auto-reloaded when changed."
-                  << std::endl;
+        LOG_WARNING("Error in inotify_init(). Config will not be auto-reloaded when changed.");
 
     inotifyCfgW = -1; // init value for no watch
 
-    const int inotifyBufSize = sizeof(inotify_event) + PATH_MAX + 1;
-    char inotifyBuf[inotifyBufSize];
-    pollfd inotifyPollFD; // should be an array, but we only need one
-    inotifyPollFD.fd = inotifyFD;
-    inotifyPollFD.events = POLLIN;
-
     // ---Load config---
+    if (cfgPath == "")
+        cfgPath = getDefaultConfigPath();
     loadConfig();
+    threadedMode = loadedCfg->threaded;
+    // Adds the missing keys, in case the config didn't exist before or is from an older version.
+    // Only done here, so the file isn't rewritten while being edited
+    config.sync();
+    watchConfig();
+
+    // ---Start recording---
+    if (recordPath != "") {
+        if (trace.open(recordPath))
+            LOG_INFO("Recording input to %s", recordPath.c_str());
+        else
+            LOG_WARNING("Cannot open trace file '%s'. Not recording.", recordPath.c_str());
+    }
 
     // ---Get display---
+    // Each thread has its own connection, but Xlib still has global state like the error handler
+    if (threadedMode)
+        XInitThreads();
     if ((display = XOpenDisplay(NULL)) == NULL) {
-        std::cerr << "Cannot open Display! Exiting..." << std::endl;
+        LOG_ERROR("Cannot open Display! Exiting...");
         return -1;
     }
     XSetErrorHandler(handleXError);
@@ -564,146 +954,160 @@ int main(int argc, char **argv) {
     XAllowEvents(display, AsyncBoth, CurrentTime);
 
     // ---Load the extension---
-    int xiExtOpcode;
-
     int ev, err;
     if (!XQueryExtension(display, "XInputExtension", &xiExtOpcode, &ev, &err)) {
-        std::cerr << "XInput extension is not available. Required to run "
-                     "sticky-cursor-screen-edges."
-                  << std::endl;
+        LOG_ERROR("XInput extension is not available. Required to run "
+                  "sticky-cursor-screen-edges.");
         return -1;
     }
 
     // ---Check the version---
+    // 2.3 is needed for barrier events, but 2.2 is enough otherwise
     int major_op = 2;
-    int minor_op = 2;
+    int minor_op = 3;
     int result = XIQueryVersion(display, &major_op, &minor_op);
     if (result == BadRequest) {
-        std::cerr << "Required version of XInput is not supported." << std::endl;
+        LOG_ERROR("Required version of XInput is not supported.");
         return -1;
     } else if (result != Success) {
-        std::cerr << "Couldn't check version of XInput" << std::endl;
+        LOG_ERROR("Couldn't check version of XInput");
         return -1;
     }
 
-    // ---Select XI events---
-    XIEventMask masks[1];
-    unsigned char mask[(XI_LASTEVENT + 7) / 8];
+    // ---Check for barriers---
+    int fixesEv, fixesErr;
+    int fixesMajor = 5, fixesMinor = 0;
+    bool barriersSupported = (major_op > 2 || minor_op >= 3) &&
+                             XFixesQueryExtension(display, &fixesEv, &fixesErr) &&
+                             XFixesQueryVersion(display, &fixesMajor, &fixesMinor) &&
+                             fixesMajor >= 5;
+    backend.barriersSupported = barriersSupported;
+    if (activeCfg->useBarriers && !barriersSupported)
+        LOG_WARNING("Pointer barriers need XFixes 5 and XInput 2.3. Grabbing the pointer instead.");
 
-    memset(mask, 0, sizeof(mask));
-    XISetMask(mask, XI_RawMotion);
+    // ---Select XI events---
+    selectXIEvents();
 
-    masks[0].deviceid = XIAllMasterDevices;
-    masks[0].mask_len = sizeof(mask);
-    masks[0].mask = mask;
+    // ---Monitor list---
+    int xrrErrorBase;
+    if (!XRRQueryExtension(display, &xrrEventBase, &xrrErrorBase)) {
+        LOG_ERROR("Xrandr extension is not available. Required to run "
+                  "sticky-cursor-screen-edges.");
+        return -1;
+    }
 
-    XISelectEvents(display, DefaultRootWindow(display), masks, 1);
-    XFlush(display);
+    // ---Window tree---
+    // PropertyChangeMask is for following the focused window
+    eventMasks.init(display);
+    eventMasks.add(rootWindow, SubstructureNotifyMask | PropertyChangeMask);
+    windowCache.init(display, rootWindow, &eventMasks);
+    activeWindow.init(display, rootWindow, &eventMasks, &backend.roundTrips);
+    configureEngine(); // with the rule of the window focused now
 
-    // ---Monitor list---
+    backend.init(display, rootWindow, &windowCache);
+    lastRoundTripReport = high_resolution_clock::now();
     updateMonitorList();
-    // notify of resolution changes
-    XSelectInput(display, rootWindow, StructureNotifyMask);
-
-    // ---Signal handlers---
+    // notify of monitor changes
+    XRRSelectInput(display, rootWindow, RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask);
+
+    // ---Signal fd---
+    signalFD = signalfd(-1, &sigMask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    // ---Timer---
+    timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    updateTick();
+    passTimerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    backend.passTimerFD = passTimerFD;
+
+    // ---Event sources---
+    epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFD == -1) {
+        LOG_ERROR("Error in epoll_create1(). Exiting...");
+        return -1;
+    }
+    // The X connection and the pass timer belong to the decision thread in threaded mode
+    int xEpollFD = epollFD;
+    if (threadedMode) {
+        wakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        decisionEpollFD = epoll_create1(EPOLL_CLOEXEC);
+        if (wakeFD == -1 || decisionEpollFD == -1) {
+            LOG_ERROR("Error in eventfd() or epoll_create1() for threaded mode. Exiting...");
+            return -1;
+        }
+        watchFD(decisionEpollFD, wakeFD);
+        xEpollFD = decisionEpollFD;
+    }
+    watchFD(xEpollFD, ConnectionNumber(display));
+    if (inotifyFD != -1)
+        watchFD(epollFD, inotifyFD);
+    if (signalFD != -1)
+        watchFD(epollFD, signalFD);
+    else
+        LOG_WARNING("Error in signalfd(). Signals will not be handled.");
+    if (timerFD != -1)
+        watchFD(epollFD, timerFD);
+    if (passTimerFD != -1)
+        watchFD(xEpollFD, passTimerFD);
+    else
+        LOG_WARNING("Error in timerfd_create(). Edges will only be passed on pointer events.");
+
+    // ---Start the threads---
     running = true;
-    reloadCfg = false;
-    signal(SIGHUP, reloadCfgSignal);
-    signal(SIGTERM, terminateSignal);
+    if (threadedMode) {
+        if (!inputThread.start(wakeFD)) {
+            LOG_ERROR("Cannot start the input thread. Exiting...");
+            return -1;
+        }
+        decisionThread = std::thread(runDecisions);
+        LOG_INFO("Running in threaded mode");
+    }
 
     // ---Event loop---
-    XEvent xevent;
+    // Only the control work in threaded mode
+    const int maxEpollEvents = 4;
+    epoll_event epollEvents[maxEpollEvents];
     while (running) {
-        // After first load, only used on SIGHUP signal or file change
-        if (reloadCfg) {
-            reloadCfg = false;
-            std::cout << "Received signal for reloading config..." << std::endl;
-            loadConfig();
+        // Xlib might have read events into its queue while waiting for a reply,
+        // in which case the socket won't wake us up
+        int timeout = -1;
+        if (!threadedMode) {
+            XFlush(display);
+            timeout = XEventsQueued(display, QueuedAlready) > 0 ? 0 : -1;
         }
 
-        // Check for config change
-        bool cfgChanged = false;
-
-        if (poll(&inotifyPollFD, 1, 0) > 0 && inotifyPollFD.revents == POLLIN) {
-            int numRead = read(inotifyFD, &inotifyBuf, inotifyBufSize);
-            int pos = 0;
-            while (pos < numRead) {
-                inotify_event *ev = (inotify_event *)(&inotifyBuf + pos);
-                if (ev->wd == inotifyCfgW && !cfgSavedByMyself) { // File has been changed
-                    cfgChanged = true;
-                }
-                pos += sizeof(inotify_event) + ev->len;
-            }
-            cfgSavedByMyself = false;
+        int numEvents = epoll_wait(epollFD, epollEvents, maxEpollEvents, timeout);
+        if (numEvents == -1 && errno != EINTR) {
+            LOG_ERROR("Error in epoll_wait(). Exiting...");
+            break;
         }
 
-        if (cfgChanged) {
-            std::cout << "Config file changed..." << std::endl;
-            loadConfig();
+        for (int i = 0; i < numEvents; i++) {
+            int fd = epollEvents[i].data.fd;
+            if (fd == inotifyFD)
+                handleInotify();
+            else if (fd == signalFD)
+                handleSignals();
+            else if (fd == timerFD)
+                handleTimer();
+            else if (fd == passTimerFD)
+                handlePassTimer();
         }
 
-        // Handle next event
-        XNextEvent(display, &xevent);
-
-        // Skip this completely if sticky edges aren't enabled
-        switch (xevent.type) {
-        case GenericEvent:
-            if (cfgEnabled && XGetEventData(display, &xevent.xcookie)) {
-                XGenericEventCookie *cookie = &xevent.xcookie;
-
-                if (cookie->extension == xiExtOpcode && cookie->evtype == XI_RawMotion) {
-                    // This is the event we were looking for
-                    XIDeviceEvent *motionEvent = (XIDeviceEvent *)cookie->data;
-
-                    Window childWnd, parentDummy;
-                    int root_x, root_y, win_x, win_y;
-                    unsigned int maskDummy;
-                    XQueryPointer(display, rootWindow, &rootWindow, &childWnd, &root_x, &root_y,
-                                  &win_x, &win_y, &maskDummy);
-
-                    pointerSpeedChanged(motionEvent->time, root_x, root_y, motionEvent->event_x,
-                                        motionEvent->event_y);
-                    if (motionEvent->event_x != 0 || motionEvent->event_y != 0 || true) {
-                        pointerPositionChanged(motionEvent->time, root_x, root_y);
-                    }
-                }
-                XFreeEventData(display, cookie);
-            }
-            break;
-        case MotionNotify:
-            pointerPositionChanged(xevent.xbutton.time, xevent.xmotion.x_root,
-                                   xevent.xmotion.y_root);
-            break;
-        case ButtonPress:
-        case ButtonRelease: {
-            // free the pointer
-            unconfinePointer();
-
-            // replay the event to the window under sursor
-            currentMonitor->snapPosition(&xevent.xbutton.x_root, &xevent.xbutton.y_root);
-            Window cursorWindow =
-                getWindowAt(rootWindow, xevent.xbutton.x_root, xevent.xbutton.y_root);
-            printf("Window under cursor: %x\n", (int)cursorWindow);
-            Window childDummy;
-            XTranslateCoordinates(display, rootWindow, cursorWindow, xevent.xbutton.x_root,
-                                  xevent.xbutton.y_root, &xevent.xbutton.x, &xevent.xbutton.y,
-                                  &childDummy);
-            xevent.xbutton.window = cursorWindow;
-            XSendEvent(display, cursorWindow, True, ButtonPressMask | ButtonReleaseMask, &xevent);
-            XFlush(display);
+        if (!threadedMode)
+            handleXEvents();
+    }
 
-            // notify of the change
-            pointerPositionChanged(xevent.xbutton.time, xevent.xbutton.x_root,
-                                   xevent.xbutton.y_root);
-            break;
-        }
-        case ConfigureNotify:
-            updateMonitorList();
-            break;
-        }
+    if (threadedMode) {
+        wakeDecisions();
+        decisionThread.join();
+        inputThread.stop();
     }
 
     // --Clean up---
+    trace.close();
+    statsFile.close();
+    asyncLog.stop();
+    backend.destroyBarriers();
     if (inotifyCfgW != -1)
         inotify_rm_watch(inotifyFD, inotifyCfgW);
 
@@ -0,0 +1,111 @@
+#include <MiIni.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "Replay.h"
+
+using namespace std::chrono;
+
+/*
+Feeds a trace recorded with `sticky-mouse-trap --record` through the engine on the fake backend,
+with the clock taken from the trace. Prints every decision, and how fast the events were handled.
+*/
+
+class PrintingListener : public ReplayListener {
+  public:
+    EventTime start;
+    unsigned long passes = 0, deadlinePasses = 0;
+    bool verbose = true;
+
+    double secondsOf(EventTime time) const { return duration<double>(time - start).count(); }
+
+    void layout(EventTime time, const std::vector<Monitor> &monitors) override {
+        if (verbose)
+            printf("%12.6f layout of %i monitors\n", secondsOf(time), (int)monitors.size());
+    }
+    void confined(EventTime time, MonitorId monitor) override {
+        if (verbose)
+            printf("%12.6f confine %i\n", secondsOf(time), monitor);
+    }
+    void released(EventTime time) override {
+        if (verbose)
+            printf("%12.6f release\n", secondsOf(time));
+    }
+    void passed(EventTime time, MonitorId from, MonitorId to, bool onDeadline) override {
+        passes++;
+        if (onDeadline)
+            deadlinePasses++;
+        if (verbose)
+            printf("%12.6f pass %i -> %i%s\n", secondsOf(time), from, to,
+                   onDeadline ? " on deadline" : "");
+    }
+};
+
+int main(int argc, char **argv) {
+    // ---Read arguments---
+    std::string tracePath, cfgPath;
+    int repeats = 1;
+    PrintingListener listener;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0)
+            listener.verbose = false;
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else if (tracePath == "")
+            tracePath = argv[i];
+        else
+            cfgPath = argv[i];
+    }
+    if (tracePath == "" || repeats < 1) {
+        fprintf(stderr, "Usage: %s [-q] [-r repeats] trace [config]\n", argv[0]);
+        return -1;
+    }
+
+    // ---Load config---
+    EngineConfig cfg;
+    if (cfgPath != "") {
+        try {
+            MiIni<std::string> config;
+            config.open(cfgPath, false);
+            readEngineConfig(config, &cfg);
+        } catch (const MiIni<>::FileError &e) {
+            std::cerr << "Error while reading configuration: " << e.what() << '\n';
+            return -1;
+        }
+    }
+
+    std::string error;
+    if (!validateEngineConfig(cfg, &error)) {
+        std::cerr << "Invalid configuration: " << error << '\n';
+        return -1;
+    }
+
+    // ---Load trace---
+    std::vector<TraceRecord> records;
+    if (!loadTrace(tracePath, &records)) {
+        std::cerr << "Cannot read trace '" << tracePath << "'" << std::endl;
+        return -1;
+    }
+    if (!records.empty())
+        listener.start = records.front().time;
+
+    // ---Replay---
+    unsigned long events = 0;
+    auto wallStart = steady_clock::now();
+    for (int i = 0; i < repeats; i++)
+        events += replayTrace(records, cfg, &listener);
+    duration<double> elapsed = steady_clock::now() - wallStart;
+
+    // ---Report---
+    printf("Events: %lu, passes: %lu (%lu on deadline), time: %.3f s\n", events, listener.passes,
+           listener.deadlinePasses, elapsed.count());
+    if (elapsed.count() > 0.0)
+        printf("Events per second: %.0f\n", events / elapsed.count());
+
+    return 0;
+}
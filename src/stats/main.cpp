@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "StatsFile.h"
+
+/*
+Prints the statistics a running sticky-mouse-trap publishes, once or at an interval. Only reads
+the mapped file, so it can be run as often as wanted without slowing the daemon down.
+*/
+
+int main(int argc, char **argv) {
+    // ---Read arguments---
+    std::string path;
+    double interval = 0.0;
+    bool badArgs = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            interval = atof(argv[++i]);
+        else if (path == "" && argv[i][0] != '-')
+            path = argv[i];
+        else
+            badArgs = true;
+    }
+    if (badArgs || interval < 0.0) {
+        fprintf(stderr, "Usage: %s [-w interval in seconds] [stats file]\n", argv[0]);
+        return -1;
+    }
+    if (path == "")
+        path = defaultStatsPath();
+    if (path == "") {
+        fprintf(stderr, "XDG_RUNTIME_DIR isn't set, pass the statistics file\n");
+        return -1;
+    }
+
+    // ---Map the file---
+    StatsReader reader;
+    std::string error;
+    if (!reader.open(path, &error)) {
+        fprintf(stderr, "Cannot read statistics from '%s': %s\n", path.c_str(), error.c_str());
+        return -1;
+    }
+
+    // ---Print---
+    StatsData data;
+    while (true) {
+        if (!reader.read(&data)) {
+            fprintf(stderr, "The statistics kept changing while being read\n");
+            return -1;
+        }
+        const StatsFileHeader &header = reader.header();
+        printf("sticky-mouse-trap %i, statistics %s\n", header.pid,
+               header.enabled.load(std::memory_order_relaxed) ? "enabled" : "disabled");
+        dumpStatsData(data, stdout);
+
+        if (interval <= 0.0)
+            break;
+        printf("\n");
+        std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+#include <MiIni.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Replay.h"
+
+using namespace std::chrono;
+
+/*
+Searches for the settings that suit recorded traces best. Each trace is labelled with what the
+user meant to do at the edges: "cross:" traces should pass quickly, "stay:" traces (hitting
+buttons on the edge) shouldn't pass at all. Every candidate is replayed on all traces, with the
+candidates spread over all cores, and the best one is written as a config file.
+*/
+
+struct Param {
+    ConfigKey key;
+    int model; // the PassModel that uses it, -1 for both
+    float lo, hi;
+    float (*get)(const EngineConfig &);
+    void (*set)(EngineConfig &, float);
+};
+
+#define FLOAT_PARAM(field, section, key, model, lo, hi)                                            \
+    Param {                                                                                        \
+        {section, key}, model, lo, hi, [](const EngineConfig &c) { return c.field; },              \
+            [](EngineConfig &c, float v) { c.field = v; }                                          \
+    }
+#define SECONDS_PARAM(field, section, key, model, lo, hi)                                          \
+    Param {                                                                                        \
+        {section, key}, model, lo, hi, [](const EngineConfig &c) { return c.field.count(); },      \
+            [](EngineConfig &c, float v) { c.field = EngineConfig::Seconds(v); }                   \
+    }
+
+const char *const movement = "Movement Calculation";
+const Param allParams[] = {
+    FLOAT_PARAM(resistanceSlowdownExponent, movement, "ResistanceSlowdownExponent",
+                PassModelSpeeds, 0.5f, 8.0f),
+    FLOAT_PARAM(resistanceSpeedupExponent, movement, "ResistanceSpeedupExponent", PassModelSpeeds,
+                0.1f, 4.0f),
+    FLOAT_PARAM(resistanceConstSpeedExponent, movement, "ResistanceConstantSpeedExponent",
+                PassModelSpeeds, 0.0f, 1.0f),
+    FLOAT_PARAM(resistanceDirectionExponent, movement, "ResistanceByDirectionExponent",
+                PassModelSpeeds, 0.0f, 3.0f),
+    FLOAT_PARAM(passthroughSmoothingFactor, movement, "PassthroughSmoothingFactor",
+                PassModelSpeeds, 0.0f, 0.5f),
+    FLOAT_PARAM(trajectoryAimPast, movement, "TrajectoryAimPastPixels", PassModelTrajectory,
+                20.0f, 400.0f),
+    SECONDS_PARAM(trajectoryHorizon, movement, "TrajectoryHorizonSeconds", PassModelTrajectory,
+                  0.02f, 0.3f),
+    FLOAT_PARAM(cornerSizeFactor, "Screen", "CornerSizeFactor", -1, 0.02f, 0.3f),
+    SECONDS_PARAM(edgePass.baseDelay, "Edge Passthrough", "BaseDelayOfSeconds", -1, 0.05f, 1.0f),
+    SECONDS_PARAM(edgePass.minDelay, "Edge Passthrough", "MinDelayOfSeconds", -1, 0.0f, 0.3f),
+    SECONDS_PARAM(edgePass.maxDelay, "Edge Passthrough", "MaxDelayOfSeconds", -1, 0.1f, 1.5f),
+    SECONDS_PARAM(cornerPass.baseDelay, "Corner Passthrough", "BaseDelayOfSeconds", -1, 0.05f,
+                  1.5f),
+    SECONDS_PARAM(cornerPass.minDelay, "Corner Passthrough", "MinDelayOfSeconds", -1, 0.0f, 0.5f),
+    SECONDS_PARAM(cornerPass.maxDelay, "Corner Passthrough", "MaxDelayOfSeconds", -1, 0.1f, 2.0f),
+};
+std::vector<Param> params; // the ones the pass model of the base config uses
+
+struct LabelledTrace {
+    std::string path;
+    bool cross; // the user meant to cross the edges
+    std::vector<TraceRecord> records;
+};
+
+/*
+Scores one replay. Intended crossings cost the time the pointer was held before passing,
+or the crossing weight if it never passed; unintended ones cost the crossing weight each.
+*/
+class Scorer : public ReplayListener {
+  public:
+    bool held = false;
+    EventTime heldSince, releasedAt;
+    double delay = 0.0; // seconds held before the passes
+    unsigned long passes = 0;
+
+    void confined(EventTime time, MonitorId monitor) override {
+        if (!held) {
+            held = true;
+            heldSince = time;
+        }
+    }
+    void released(EventTime time) override {
+        held = false;
+        releasedAt = time;
+    }
+    void passed(EventTime time, MonitorId from, MonitorId to, bool onDeadline) override {
+        passes++;
+        // Released by this very pass
+        if (releasedAt == time)
+            delay += duration<double>(time - heldSince).count();
+    }
+};
+
+std::vector<LabelledTrace> traces;
+float crossWeight = 1.0f; // cost of a wrong crossing, in seconds of delay
+std::atomic<unsigned long> eventsReplayed(0);
+
+double evaluate(const EngineConfig &cfg) {
+    double cost = 0.0;
+    unsigned long events = 0;
+    for (const LabelledTrace &trace : traces) {
+        Scorer scorer;
+        events += replayTrace(trace.records, cfg, &scorer);
+        if (trace.cross)
+            cost += scorer.delay + (scorer.passes == 0 ? crossWeight : 0.0);
+        else
+            cost += scorer.passes * crossWeight;
+    }
+    eventsReplayed += events;
+    return cost;
+}
+
+// Keeps the delays ordered the way the engine expects
+void fixup(EngineConfig &cfg) {
+    for (PassConfig *pass : {&cfg.edgePass, &cfg.cornerPass}) {
+        if (pass->minDelay > pass->maxDelay)
+            std::swap(pass->minDelay, pass->maxDelay);
+    }
+}
+
+void evaluateAll(const std::vector<EngineConfig> &candidates, std::vector<double> *costs,
+                 int numThreads) {
+    costs->assign(candidates.size(), 0.0);
+    std::atomic<size_t> next(0);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&]() {
+            size_t i;
+            while ((i = next++) < candidates.size())
+                (*costs)[i] = evaluate(candidates[i]);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+int main(int argc, char **argv) {
+    // ---Read arguments---
+    std::string basePath, outPath = "sticky-mouse-trap.cfg";
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    int rounds = 8, perRound = 256;
+    bool badArgs = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            basePath = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            numThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            perRound = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            crossWeight = atof(argv[++i]);
+        else if (strncmp(argv[i], "cross:", 6) == 0)
+            traces.push_back(LabelledTrace{argv[i] + 6, true, {}});
+        else if (strncmp(argv[i], "stay:", 5) == 0)
+            traces.push_back(LabelledTrace{argv[i] + 5, false, {}});
+        else
+            badArgs = true;
+    }
+    if (badArgs || traces.empty() || numThreads < 1 || rounds < 1 || perRound < 1) {
+        fprintf(stderr,
+                "Usage: %s [-c base config] [-o output config] [-j threads] [-r rounds]\n"
+                "       [-n candidates per round] [-w crossing weight] "
+                "cross:trace... stay:trace...\n",
+                argv[0]);
+        return -1;
+    }
+
+    // ---Load config---
+    EngineConfig base;
+    if (basePath != "") {
+        try {
+            MiIni<std::string> config;
+            config.open(basePath, false);
+            readEngineConfig(config, &base);
+        } catch (const MiIni<>::FileError &e) {
+            std::cerr << "Error while reading configuration: " << e.what() << '\n';
+            return -1;
+        }
+    }
+
+    std::string error;
+    if (!validateEngineConfig(base, &error)) {
+        std::cerr << "Invalid base configuration: " << error << '\n';
+        return -1;
+    }
+    for (const Param &p : allParams)
+        if (p.model == -1 || p.model == base.passModel)
+            params.push_back(p);
+
+    // ---Load traces---
+    for (LabelledTrace &trace : traces) {
+        if (!loadTrace(trace.path, &trace.records)) {
+            std::cerr << "Cannot read trace '" << trace.path << "'" << std::endl;
+            return -1;
+        }
+    }
+
+    // ---Search---
+    // Random candidates first, then narrower and narrower ones around the best so far
+    std::mt19937 rng(1);
+    EngineConfig best = base;
+    double bestCost = 0.0, baseCost = 0.0;
+    auto wallStart = steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        std::vector<EngineConfig> candidates;
+        candidates.push_back(best);
+        float spread = 0.25f * std::pow(0.5f, (float)round);
+        // Candidates the engine wouldn't accept, e.g. with an app rule, are drawn again
+        for (int tries = 0; (int)candidates.size() < perRound && tries < perRound * 100; tries++) {
+            EngineConfig cfg = best;
+            for (const Param &p : params) {
+                float value;
+                if (round == 0) {
+                    value = std::uniform_real_distribution<float>(p.lo, p.hi)(rng);
+                } else {
+                    std::normal_distribution<float> step(0.0f, (p.hi - p.lo) * spread);
+                    value = std::max(p.lo, std::min(p.get(cfg) + step(rng), p.hi));
+                }
+                p.set(cfg, value);
+            }
+            fixup(cfg);
+            if (validateEngineConfig(cfg, &error))
+                candidates.push_back(cfg);
+        }
+
+        std::vector<double> costs;
+        evaluateAll(candidates, &costs, numThreads);
+        if (round == 0)
+            baseCost = bestCost = costs[0];
+        for (size_t i = 0; i < costs.size(); i++) {
+            if (costs[i] < bestCost) {
+                bestCost = costs[i];
+                best = candidates[i];
+            }
+        }
+        printf("Round %i: best cost %.4f\n", round + 1, bestCost);
+    }
+    duration<double> elapsed = steady_clock::now() - wallStart;
+
+    // ---Report---
+    printf("Cost of the starting config: %.4f, of the best: %.4f\n", baseCost, bestCost);
+    for (const Param &p : params)
+        printf("  %-56s %8.4f -> %8.4f\n", ("[" + p.key.section + "] " + p.key.key).c_str(),
+               p.get(base), p.get(best));
+    printf("Replayed %lu events in %.3f s on %i threads, %.0f events per second per thread\n",
+           eventsReplayed.load(), elapsed.count(), numThreads,
+           eventsReplayed.load() / elapsed.count() / numThreads);
+
+    // Only the tuned keys change, the rest of the base config is kept
+    std::vector<ConfigKey> keys;
+    for (const Param &p : params)
+        keys.push_back(p.key);
+    writeEngineConfig(outPath, best, basePath, keys);
+    printf("Wrote %s\n", outPath.c_str());
+
+    return 0;
+}
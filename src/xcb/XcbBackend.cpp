@@ -0,0 +1,210 @@
+#include "XcbBackend.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/randr.h>
+#include <xcb/xcbext.h>
+#include <xcb/xinput.h>
+
+#include "Log.h"
+
+void XcbBackend::init(Display *newDisplay, Window newRoot, WindowCache *newWindowCache) {
+    conn = XGetXCBConnection(newDisplay);
+
+    // Asked for now, so the first request of each extension doesn't wait for it
+    xcb_prefetch_extension_data(conn, &xcb_randr_id);
+    xcb_prefetch_extension_data(conn, &xcb_input_id);
+    X11Backend::init(newDisplay, newRoot, newWindowCache);
+}
+
+// All atoms in a single round-trip
+void XcbBackend::internAtoms() {
+    const char *const names[] = {"_NET_WM_STATE", "_NET_WM_STATE_FULLSCREEN",
+                                 "_NET_WM_WINDOW_TYPE", "_NET_WM_WINDOW_TYPE_DESKTOP"};
+    const bool onlyIfExists[] = {true, true, false, false};
+    Atom *atoms[] = {&atomWmState, &atomWmStateFullscreen, &atomWmWindowType,
+                     &atomWmWindowTypeDesktop};
+    const int count = sizeof(names) / sizeof(names[0]);
+
+    xcb_intern_atom_cookie_t cookies[count];
+    for (int i = 0; i < count; i++)
+        cookies[i] = xcb_intern_atom(conn, onlyIfExists[i], strlen(names[i]), names[i]);
+    roundTrips++;
+    for (int i = 0; i < count; i++) {
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn, cookies[i], nullptr);
+        *atoms[i] = reply ? reply->atom : None;
+        free(reply);
+    }
+}
+
+/*
+Two round-trips: the monitors, then the names of all of them together.
+*/
+void XcbBackend::readMonitors(std::vector<MonitorWindow> *monitors) {
+    if (!monitorsSupported) {
+        readCrtcs(monitors);
+        return;
+    }
+
+    roundTrips++;
+    xcb_randr_get_monitors_reply_t *reply =
+        xcb_randr_get_monitors_reply(conn, xcb_randr_get_monitors(conn, root, true), nullptr);
+    if (!reply) {
+        LOG_ERROR("Couldn't read the monitors");
+        return;
+    }
+    std::vector<xcb_get_atom_name_cookie_t> nameCookies;
+    for (xcb_randr_monitor_info_iterator_t it = xcb_randr_get_monitors_monitors_iterator(reply);
+         it.rem; xcb_randr_monitor_info_next(&it)) {
+        const xcb_randr_monitor_info_t *info = it.data;
+        monitors->push_back(MonitorWindow{NoMonitor, info->name, info->x, info->y, info->width,
+                                          info->height, None, 0});
+        nameCookies.push_back(xcb_get_atom_name(conn, info->name));
+    }
+    free(reply);
+
+    // Profiles in the config refer to monitors by name, which is the output's for automatic ones
+    if (!nameCookies.empty())
+        roundTrips++;
+    for (size_t j = 0; j < nameCookies.size(); j++) {
+        xcb_get_atom_name_reply_t *name = xcb_get_atom_name_reply(conn, nameCookies[j], nullptr);
+        if (name) {
+            (*monitors)[j].name =
+                std::string(xcb_get_atom_name_name(name), xcb_get_atom_name_name_length(name));
+            free(name);
+        }
+    }
+}
+
+/*
+Three round-trips, before RandR 1.5: the resources, then the infos of all CRTCs together, then the
+infos of their outputs together.
+*/
+void XcbBackend::readCrtcs(std::vector<MonitorWindow> *crtcs) {
+    roundTrips++;
+    xcb_randr_get_screen_resources_current_reply_t *res =
+        xcb_randr_get_screen_resources_current_reply(
+            conn, xcb_randr_get_screen_resources_current(conn, root), nullptr);
+    if (!res) {
+        LOG_ERROR("Couldn't read the screen resources");
+        return;
+    }
+    const xcb_randr_crtc_t *ids = xcb_randr_get_screen_resources_current_crtcs(res);
+    const int count = xcb_randr_get_screen_resources_current_crtcs_length(res);
+
+    std::vector<xcb_randr_get_crtc_info_cookie_t> crtcCookies(count);
+    for (int j = 0; j < count; j++)
+        crtcCookies[j] = xcb_randr_get_crtc_info(conn, ids[j], res->config_timestamp);
+
+    // The output of each enabled CRTC is asked for as soon as the CRTC's info is there
+    std::vector<xcb_randr_get_output_info_cookie_t> outputCookies;
+    roundTrips++;
+    for (int j = 0; j < count; j++) {
+        xcb_randr_get_crtc_info_reply_t *info =
+            xcb_randr_get_crtc_info_reply(conn, crtcCookies[j], nullptr);
+        if (info && info->num_outputs) {
+            crtcs->push_back(MonitorWindow{NoMonitor, ids[j], info->x, info->y, info->width,
+                                           info->height, None, 0});
+            outputCookies.push_back(xcb_randr_get_output_info(
+                conn, xcb_randr_get_crtc_info_outputs(info)[0], res->config_timestamp));
+        }
+        free(info);
+    }
+    free(res);
+
+    // Profiles in the config refer to monitors by output name
+    if (!outputCookies.empty())
+        roundTrips++;
+    for (size_t j = 0; j < outputCookies.size(); j++) {
+        xcb_randr_get_output_info_reply_t *output =
+            xcb_randr_get_output_info_reply(conn, outputCookies[j], nullptr);
+        if (output) {
+            (*crtcs)[j].name = std::string((const char *)xcb_randr_get_output_info_name(output),
+                                           xcb_randr_get_output_info_name_length(output));
+            free(output);
+        }
+    }
+}
+
+/*
+The one reply that's still waited for: the engine resyncs its tracked position with the answer.
+*/
+void XcbBackend::queryPointer(DeviceId device, int *x, int *y) {
+    roundTrips++;
+    xcb_input_xi_query_pointer_reply_t *reply = xcb_input_xi_query_pointer_reply(
+        conn, xcb_input_xi_query_pointer(conn, root, device), nullptr);
+    // 16.16 fixed point, truncated like the Xlib backend does
+    *x = reply ? reply->root_x / 65536 : 0;
+    *y = reply ? reply->root_y / 65536 : 0;
+    free(reply);
+}
+
+void XcbBackend::warpPointer(DeviceId device, int x, int y) {
+    xcb_input_xi_warp_pointer(conn, XCB_NONE, root, 0, 0, 0, 0, x * 65536, y * 65536, device);
+    xcb_flush(conn);
+}
+
+/*
+Not flushed: the engine warps the pointer right after confining it, which sends the map, the grab
+and the warp together.
+*/
+void XcbBackend::confine(DeviceId device, const Monitor &mon) {
+    // The barriers already hold the pointer. Other pointers than ours can't be grabbed
+    if (usingBarriers() || pointerConfined != None || device != clientDevice)
+        return;
+
+    for (const MonitorWindow &win : windows) {
+        if (win.id != mon.id)
+            continue;
+
+        // show the (invisible) window so it can grab the pointer
+        xcb_map_window(conn, win.inputWindow);
+
+        // Nothing is decided on whether the grab succeeded, so its reply is only looked at later
+        grabCookie = xcb_grab_pointer(conn, false, win.inputWindow,
+                                      XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE |
+                                          XCB_EVENT_MASK_POINTER_MOTION,
+                                      XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC, win.inputWindow,
+                                      XCB_NONE, lastEventTime);
+        grabPending = true;
+
+        pointerConfined = win.inputWindow;
+        LOG_DEBUG("Confined pointer to x:%5i y:%5i w:%4i h:%4i, Window %x", win.x, win.y, win.w,
+                  win.h, (int)win.inputWindow);
+        break;
+    }
+}
+
+void XcbBackend::release(DeviceId device) {
+    if (pointerConfined == None || device != clientDevice) {
+        // Let through a barrier
+        X11Backend::release(device);
+        return;
+    }
+
+    checkGrab();
+    xcb_ungrab_pointer(conn, lastEventTime);
+    xcb_unmap_window(conn, pointerConfined);
+    xcb_allow_events(conn, XCB_ALLOW_REPLAY_POINTER, lastEventTime);
+    xcb_flush(conn);
+    pointerConfined = None;
+    LOG_DEBUG("Unconfined pointer");
+}
+
+void XcbBackend::checkGrab() {
+    if (!grabPending)
+        return;
+    grabPending = false;
+
+    void *reply = nullptr;
+    xcb_generic_error_t *error = nullptr;
+    if (!xcb_poll_for_reply(conn, grabCookie.sequence, &reply, &error)) {
+        xcb_discard_reply(conn, grabCookie.sequence);
+        return;
+    }
+    xcb_grab_pointer_reply_t *grab = (xcb_grab_pointer_reply_t *)reply;
+    if (grab && grab->status != XCB_GRAB_STATUS_SUCCESS)
+        LOG_WARNING("The pointer couldn't be grabbed, status %i", (int)grab->status);
+    free(reply);
+    free(error);
+}
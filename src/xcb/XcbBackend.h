@@ -0,0 +1,40 @@
+#pragma once
+
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include "X11Backend.h"
+
+/*
+The X11 backend with its requests made on the XCB connection underneath Xlib, which is built
+with -DSTICKY_XCB=ON. Independent requests are sent together and their replies collected after,
+so reading the monitors costs two round-trips however many there are, and confining sends the
+grab and the warp in one flush without waiting for the grab's reply. Only the pointer query still
+waits, as the engine decides on its answer.
+
+Xlib and XCB keep the requests on the shared connection in order, and Xlib still reads the
+events, so the rest of the daemon is unchanged.
+*/
+class XcbBackend : public X11Backend {
+  public:
+    void init(Display *display, Window root, WindowCache *windowCache);
+
+    void queryPointer(DeviceId device, int *x, int *y) override;
+    void warpPointer(DeviceId device, int x, int y) override;
+    void confine(DeviceId device, const Monitor &mon) override;
+    void release(DeviceId device) override;
+
+  protected:
+    void internAtoms() override;
+    void readMonitors(std::vector<MonitorWindow> *monitors) override;
+    void readCrtcs(std::vector<MonitorWindow> *crtcs) override;
+
+  private:
+    // Logs a grab that failed, if its reply arrived, or drops the reply
+    void checkGrab();
+
+    xcb_connection_t *conn = nullptr;
+    bool grabPending = false; // the reply of the last grab wasn't looked at yet
+    xcb_grab_pointer_cookie_t grabCookie;
+};